@@ -0,0 +1,39 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Measure how many of a burst of whispers a busy receiver gets, and how long each
+# #recv takes afterwards, with and without a background reader draining the node
+# while the receiving Ruby thread is busy.
+
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+BURST = 20_000
+BUSY_TIME = 2.0
+
+
+[ false, true ].each do |use_reader|
+	sender, receiver = started_nodes( 2 )
+	wait_for_peers( sender, receiver )
+	receiver.start_reader( capacity: BURST ) if use_reader
+
+	label = use_reader ? "with reader" : "without reader"
+
+	BURST.times {|i| sender.whisper(receiver.uuid, i.to_s) }
+
+	# Keep the receiving thread busy while the burst arrives
+	deadline = now() + BUSY_TIME
+	nil while now() < deadline
+
+	received = 0
+	start = now()
+	received += 1 while receiver.recv( timeout: 0.5 )
+	elapsed = now() - start - 0.5
+
+	report( "#{label}: received", received, "of #{BURST}" )
+	report( "#{label}: recv, per event", elapsed / [received, 1].max * 1_000_000, 'usec' )
+	report( "#{label}: reader high water", receiver.reader_stats[:high_water], 'events' ) if use_reader
+
+	[ sender, receiver ].each( &:stop )
+end
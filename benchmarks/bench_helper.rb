@@ -0,0 +1,65 @@
+# -*- ruby -*-
+# frozen_string_literal: true
+
+$LOAD_PATH.unshift( File.expand_path('../lib', __dir__) )
+
+require 'securerandom'
+require 'zyre'
+
+
+# Helper functions for the benchmarks in this directory. Run them against a
+# compiled extension, e.g.:
+#
+#   rake compile && ruby benchmarks/frame_building.rb
+#
+module Zyre::BenchHelper
+
+	###############
+	module_function
+	###############
+
+	### Return an Array of +count+ nodes which have been started and connected to
+	### each other via an in-process gossip hub.
+	def started_nodes( count )
+		hub = "inproc://bench-gossip-hub-%s" % [ SecureRandom.hex(16) ]
+
+		return Array.new( count ) do |i|
+			node = Zyre::Node.new
+			node.endpoint = "inproc://bench-node-%s" % [ SecureRandom.hex(16) ]
+			yield( node ) if block_given?
+
+			if i.zero?
+				node.gossip_bind( hub )
+				sleep 0.25
+			else
+				node.gossip_connect( hub )
+			end
+
+			node.start
+			node
+		end
+	end
+
+
+	### Wait for each of the +nodes+ to see an ENTER for every other one.
+	def wait_for_peers( *nodes )
+		nodes.flatten!
+		nodes.each do |node|
+			(nodes.length - 1).times { node.wait_for(:ENTER, timeout: 5) or raise "no ENTER" }
+		end
+	end
+
+
+	### Return the monotonic time.
+	def now
+		return Process.clock_gettime( Process::CLOCK_MONOTONIC )
+	end
+
+
+	### Print a line of a report with a +label+, an +amount+ and a +unit+.
+	def report( label, amount, unit )
+		printf( "%-40s %14.1f %s\n", label, amount, unit )
+	end
+
+end # module Zyre::BenchHelper
+
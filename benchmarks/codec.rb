@@ -0,0 +1,66 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Compare a whisper round trip of a structured payload through the native codec
+# (Node#whisper_encoded + Event#decoded_msg) against encoding and decoding it with
+# the msgpack gem, if it's installed.
+
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+ROUNDS = 20
+# Rounds are smaller than zyre's peer mailbox high-water mark
+ROUND = 1_000
+
+PAYLOAD = {
+	'type' => 'state',
+	'node' => SecureRandom.uuid,
+	'seq' => 123_456,
+	'load' => [ 0.25, 0.5, 0.75 ],
+	'tags' => %w[alpha beta gamma],
+	'ok' => true,
+}.freeze
+
+
+### Whisper ROUNDS * ROUND payloads from +sender+ to +receiver+ with the given
+### +send+ and +decode+ blocks, and return the rate.
+def round_trip_rate( sender, receiver, send, decode )
+	start = now()
+
+	ROUNDS.times do
+		ROUND.times { send.call(sender, receiver.uuid) }
+		received = 0
+		while received < ROUND
+			receiver.recv_batch( max: ROUND, timeout: 1 ).each do |event|
+				next unless event.is_a?( Zyre::Event::Whisper )
+				decode.call( event )
+				received += 1
+			end
+		end
+	end
+
+	return ROUNDS * ROUND / ( now() - start )
+end
+
+
+sender, receiver = started_nodes( 2 )
+wait_for_peers( sender, receiver )
+
+rate = round_trip_rate( sender, receiver,
+	->( node, uuid ) { node.whisper_encoded(uuid, PAYLOAD) },
+	->( event ) { event.decoded_msg } )
+report( "native codec", rate, 'msgs/s' )
+
+begin
+	require 'msgpack'
+
+	rate = round_trip_rate( sender, receiver,
+		->( node, uuid ) { node.whisper(uuid, MessagePack.pack(PAYLOAD)) },
+		->( event ) { MessagePack.unpack(event.msg) } )
+	report( "msgpack gem", rate, 'msgs/s' )
+rescue LoadError
+	$stderr.puts "Install the msgpack gem to compare against it."
+end
+
+[ sender, receiver ].each( &:stop )
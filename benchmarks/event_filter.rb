@@ -0,0 +1,45 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Measure how fast a receiver gets through a mix of shouts to two groups when it
+# only wants one of them, discarding the rest in Ruby versus filtering them out
+# natively, and how many objects each allocates.
+
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+ROUND = 10_000
+
+
+[ false, true ].each do |use_filter|
+	sender, receiver = started_nodes( 2 )
+	receiver.join( 'wanted' )
+	receiver.join( 'unwanted' )
+	wait_for_peers( sender, receiver )
+	sender.wait_for( :JOIN, group: 'unwanted', timeout: 5 ) or raise "no JOIN"
+	receiver.filter = { types: [:SHOUT], groups: ['wanted'] } if use_filter
+
+	label = use_filter ? "native filter" : "Ruby filter"
+
+	ROUND.times do |i|
+		sender.shout( i.even? ? 'wanted' : 'unwanted', i.to_s )
+	end
+
+	wanted = 0
+	objects = GC.stat( :total_allocated_objects )
+	start = now()
+	while wanted < ROUND / 2
+		receiver.recv_batch( max: 1_000, timeout: 1 ).each do |event|
+			next unless event.is_a?( Zyre::Event::Shout ) && event.group == 'wanted'
+			wanted += 1
+		end
+	end
+	elapsed = now() - start
+	objects = GC.stat( :total_allocated_objects ) - objects
+
+	report( "#{label}: wanted events", wanted / elapsed, 'events/s' )
+	report( "#{label}: allocations, per wanted event", objects / wanted.to_f, 'objects' )
+
+	[ sender, receiver ].each( &:stop )
+end
@@ -0,0 +1,37 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Measure the per-event cost of reading and wrapping queued events, alongside the
+# cost of the Ruby-level type dispatch (Event.type_by_name + allocation) that
+# wrapping used to do for every event.
+
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+ITERATIONS = 1_000_000
+ROUNDS = 20
+# Rounds are smaller than zyre's peer mailbox high-water mark
+ROUND = 1_000
+
+
+sender, receiver = started_nodes( 2 )
+wait_for_peers( sender, receiver )
+
+elapsed = 0.0
+ROUNDS.times do
+	ROUND.times { sender.whisper(receiver.uuid, 'x') }
+	sleep 0.25
+
+	start = now()
+	received = 0
+	received += receiver.recv_batch( max: ROUND, timeout: 1 ).size while received < ROUND
+	elapsed += now() - start
+end
+report( "read + wrap, per event", elapsed / (ROUNDS * ROUND) * 1_000_000, 'usec' )
+
+start = now()
+ITERATIONS.times { Zyre::Event.type_by_name('WHISPER').allocate }
+report( "type_by_name + allocate, per event", (now() - start) / ITERATIONS * 1_000_000, 'usec' )
+
+[ sender, receiver ].each( &:stop )
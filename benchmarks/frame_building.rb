@@ -0,0 +1,57 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Measure how many payload bytes/sec Zyre::Node#shout can hand to the zyre actor
+# for different frame sizes, with and without zero-copy sends of frozen Strings.
+# The shouts go to a group with no members, so this measures frame building and
+# the trip to the actor rather than the network. To compare against an older
+# build of the extension, run this script with that build's lib/ on the load
+# path; the "copy" column is what it measures. Frames under 64KB are copied even
+# with zero-copy on, since pinning them costs more than copying them; the 16KB
+# and 64KB rows show where that crosses over.
+
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+SIZES = {
+	'64B' => 64,
+	'4KB' => 4 * 1024,
+	'16KB' => 16 * 1024,
+	'64KB' => 64 * 1024,
+	'1MB' => 1024 * 1024,
+}
+DURATION = 1.0
+
+
+### Shout +payload+ as fast as possible for DURATION seconds and return the
+### throughput in bytes/sec.
+def measure( node, payload )
+	count = 0
+	start = now()
+	deadline = start + DURATION
+
+	while now() < deadline
+		100.times { node.shout('bench-nobody-listening', payload) }
+		count += 100
+	end
+
+	return ( count * payload.bytesize ) / ( now() - start )
+end
+
+
+node = started_nodes( 1 ).first
+zero_copy_supported = node.respond_to?( :zero_copy= )
+
+SIZES.each do |label, size|
+	payload = SecureRandom.random_bytes( size ).freeze
+
+	node.zero_copy = false if zero_copy_supported
+	report( "#{label} frames (copy)", measure(node, payload) / 1_048_576.0, 'MB/s' )
+
+	next unless zero_copy_supported
+	node.zero_copy = true
+	report( "#{label} frames (zero-copy)", measure(node, payload) / 1_048_576.0, 'MB/s' )
+end
+
+node.stop
@@ -0,0 +1,53 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Show how much progress a CPU-bound Ruby thread makes while another thread is
+# busy with large whispers and peer queries. Without the GVL being released
+# during the actor round trips, the counter thread stalls for their duration.
+
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+DURATION = 2.0
+WHISPER_SIZE = 16 * 1024 * 1024
+
+
+### Run the given block repeatedly for DURATION seconds while a second thread
+### counts as fast as it can, and return the counter thread's rate.
+def counter_rate
+	count = 0
+	running = true
+	counter = Thread.new do
+		count += 1 while running
+	end
+
+	start = now()
+	yield while now() - start < DURATION
+	running = false
+	counter.join
+
+	return count / ( now() - start )
+end
+
+
+node1, node2 = started_nodes( 2 )
+wait_for_peers( node1, node2 )
+payload = SecureRandom.random_bytes( WHISPER_SIZE ).freeze
+
+report( "counter thread, main thread sleeping", counter_rate { sleep 0.1 }, 'incr/s' )
+
+rate = counter_rate do
+	node1.whisper( node2.uuid, payload )
+	node2.recv
+end
+report( "counter thread, 16MB whispers", rate, 'incr/s' )
+
+rate = counter_rate do
+	node1.peers
+	node1.peer_groups
+	node1.peer_header_value( node2.uuid, 'X-Nonexistent' )
+end
+report( "counter thread, peer queries", rate, 'incr/s' )
+
+[ node1, node2 ].each( &:stop )
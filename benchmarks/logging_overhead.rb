@@ -0,0 +1,48 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Measure the cost of the Poller#wait and Node#recv hot paths with the Zyre logger
+# at :info, where their debug messages are skipped before being formatted, and at
+# :debug (logging to /dev/null) for comparison.
+
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+ITERATIONS = 100_000
+MESSAGES = 20_000
+
+
+### Return the number of zero-timeout Poller#waits per second.
+def wait_rate( poller )
+	start = now()
+	ITERATIONS.times { poller.wait(0) }
+	return ITERATIONS / ( now() - start )
+end
+
+
+### Return the number of whispers per second that can be sent from +sender+ and
+### received by +receiver+.
+def recv_rate( sender, receiver )
+	start = now()
+	( MESSAGES / 1000 ).times do
+		1000.times { sender.whisper(receiver.uuid, 'ping') }
+		1000.times { receiver.recv }
+	end
+	return MESSAGES / ( now() - start )
+end
+
+
+node1, node2 = started_nodes( 2 )
+wait_for_peers( node1, node2 )
+poller = Zyre::Poller.new( node1 )
+
+Zyre.logger = Loggability::Logger.new( File::NULL )
+
+[ :info, :debug ].each do |level|
+	Zyre.logger.level = level
+	report( "Poller#wait(0), logging at :#{level}", wait_rate(poller), 'calls/s' )
+	report( "Node#recv, logging at :#{level}", recv_rate(node1, node2), 'msgs/s' )
+end
+
+[ node1, node2 ].each( &:stop )
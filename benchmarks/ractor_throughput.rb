@@ -0,0 +1,71 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Measure the aggregate rate of encoded whisper round trips (send, receive,
+# decode) with one pair of nodes per Ractor, for increasing numbers of Ractors.
+
+require 'etc'
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+abort "This benchmark needs Ractors" unless defined?( Ractor )
+Warning[ :experimental ] = false
+
+ROUNDS = 20
+# Rounds are smaller than zyre's peer mailbox high-water mark
+ROUND = 1_000
+MAX_RACTORS = [ Etc.nprocessors, 8 ].min
+
+PAYLOAD = Ractor.make_shareable({
+	'type' => 'state',
+	'seq' => 123_456,
+	'load' => [ 0.25, 0.5, 0.75 ],
+	'tags' => %w[alpha beta gamma],
+	'ok' => true,
+})
+
+
+### Start a pair of nodes connected by a gossip hub unique to +index+, whisper
+### ROUNDS * ROUND encoded payloads between them, and return the number decoded.
+def run_pair( index )
+	prefix = "inproc://bench-ractor-%d-%d" % [ Process.pid, index ]
+	receiver, sender = [ 'receiver', 'sender' ].map do |name|
+		node = Zyre::Node.new
+		node.endpoint = "#{prefix}-#{name}"
+		node
+	end
+
+	receiver.gossip_bind( "#{prefix}-hub" )
+	sender.gossip_connect( "#{prefix}-hub" )
+	[ receiver, sender ].each( &:start )
+	receiver.wait_for( :ENTER, timeout: 5 ) or raise "no ENTER"
+	sender.wait_for( :ENTER, timeout: 5 ) or raise "no ENTER"
+
+	decoded = 0
+	ROUNDS.times do
+		ROUND.times { sender.whisper_encoded(receiver.uuid, PAYLOAD) }
+		received = 0
+		while received < ROUND
+			receiver.recv_batch( max: ROUND, timeout: 1 ).each do |event|
+				next unless event.is_a?( Zyre::Event::Whisper )
+				decoded += 1 if event.decoded_msg
+				received += 1
+			end
+		end
+	end
+
+	[ sender, receiver ].each( &:stop )
+	return decoded
+end
+
+
+count = 1
+while count <= MAX_RACTORS
+	start = now()
+	ractors = Array.new( count ) {|i| Ractor.new(i) {|index| run_pair(index) } }
+	total = ractors.sum {|r| r.respond_to?(:value) ? r.value : r.take }
+
+	report( "%d Ractor(s)" % [ count ], total / (now() - start), 'msgs/s' )
+	count *= 2
+end
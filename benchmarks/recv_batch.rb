@@ -0,0 +1,53 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Compare draining a burst of SHOUTs with a Zyre::Node#recv loop against
+# Zyre::Node#recv_batch.
+
+require_relative 'bench_helper'
+
+include Zyre::BenchHelper
+
+# Bursts are sent in rounds smaller than zyre's peer mailbox high-water mark
+BURST = 10_000
+ROUND = 1_000
+BATCH_SIZE = 256
+
+
+### Shout a burst of BURST messages from +sender+ in rounds, draining each round
+### from +receiver+ with the given block once it's queued up, and return the
+### total time spent draining.
+def drain( sender, receiver )
+	elapsed = 0.0
+
+	( BURST / ROUND ).times do
+		ROUND.times {|i| sender.shout('bench', i.to_s) }
+		sleep 0.25
+
+		start = now()
+		received = 0
+		received += yield( receiver ) while received < ROUND
+		elapsed += now() - start
+	end
+
+	return elapsed
+end
+
+
+sender, receiver = started_nodes( 2 )
+sender.join( 'bench' )
+receiver.join( 'bench' )
+wait_for_peers( sender, receiver )
+receiver.wait_for( :JOIN, timeout: 5 ) or abort "sender never joined"
+
+elapsed = drain( sender, receiver ) do |node|
+	node.recv.is_a?( Zyre::Event::Shout ) ? 1 : 0
+end
+report( "recv loop", BURST / elapsed, 'events/s' )
+
+elapsed = drain( sender, receiver ) do |node|
+	node.recv_batch( max: BATCH_SIZE ).grep( Zyre::Event::Shout ).size
+end
+report( "recv_batch(max: #{BATCH_SIZE})", BURST / elapsed, 'events/s' )
+
+[ sender, receiver ].each( &:stop )
@@ -0,0 +1,565 @@
+/*
+ *  codec.c - A minimal MessagePack codec for message frames
+ *  $Id$
+ *
+ *  Authors:
+ *    * Michael Granger <ged@FaerieMUD.org>
+ *
+ */
+
+#include "zyre_ext.h"
+
+VALUE rzyre_mZyreCodec;
+
+// How deeply Arrays and Hashes can be nested before encoding or decoding fails
+#define RZYRE_CODEC_MAX_DEPTH 512
+
+// The size of the buffer an encoder starts with
+#define RZYRE_CODEC_INITIAL_CAPACITY 256
+
+
+/* --------------------------------------------------------------
+ * Encoding
+ * -------------------------------------------------------------- */
+
+// The state of an encoding. The buffer is malloc()ed and grown as needed unless
+// the encoder is +fixed+, in which case it's either the memory of a frame that's
+// already big enough, or NULL to only count how many bytes would be encoded.
+typedef struct {
+	byte *buf;
+	size_t len;
+	size_t capacity;
+	int depth;
+	int fixed;
+} rzyre_encoder_t;
+
+
+static void rzyre_encode_object( rzyre_encoder_t *enc, VALUE obj );
+
+
+/*
+ * Make sure the encoder has room for +size+ more bytes.
+ */
+static void
+rzyre_encoder_reserve( rzyre_encoder_t *enc, size_t size )
+{
+	size_t capacity = enc->capacity ? enc->capacity : RZYRE_CODEC_INITIAL_CAPACITY;
+	byte *buf;
+
+	if ( enc->len + size <= enc->capacity ) return;
+	if ( enc->fixed ) rb_raise( rb_eRuntimeError, "object changed while it was being encoded" );
+
+	while ( capacity < enc->len + size ) capacity *= 2;
+	if ( !(buf = realloc(enc->buf, capacity)) ) rb_memerror();
+
+	enc->buf = buf;
+	enc->capacity = capacity;
+}
+
+
+/*
+ * Append a type +tag+ followed by the +size+ low bytes of +value+ in big-endian
+ * order.
+ */
+static void
+rzyre_encoder_put( rzyre_encoder_t *enc, byte tag, uint64_t value, int size )
+{
+	rzyre_encoder_reserve( enc, 1 + size );
+
+	if ( !enc->buf ) {
+		enc->len += 1 + size;
+		return;
+	}
+
+	enc->buf[ enc->len++ ] = tag;
+	while ( size-- > 0 ) {
+		enc->buf[ enc->len++ ] = (byte)( value >> (size * 8) );
+	}
+}
+
+
+/*
+ * Append a header for a String, Array, or Hash of +count+ bytes/elements, using
+ * the +fixtag+ form (if not 0) when +count+ is less than +fixmax+, or else the
+ * +tag8+ form (if not 0), the +tag16+ form, or the 32-bit form that follows it.
+ */
+static void
+rzyre_encoder_put_header( rzyre_encoder_t *enc, size_t count, byte fixtag, size_t fixmax,
+	byte tag8, byte tag16 )
+{
+	if ( fixtag && count < fixmax )
+		rzyre_encoder_put( enc, fixtag | (byte)count, 0, 0 );
+	else if ( tag8 && count <= UINT8_MAX )
+		rzyre_encoder_put( enc, tag8, count, 1 );
+	else if ( count <= UINT16_MAX )
+		rzyre_encoder_put( enc, tag16, count, 2 );
+	else if ( count <= UINT32_MAX )
+		rzyre_encoder_put( enc, tag16 + 1, count, 4 );
+	else
+		rb_raise( rb_eRangeError, "too large to encode (%lu)", (unsigned long)count );
+}
+
+
+/*
+ * Append the given Integer.
+ */
+static void
+rzyre_encode_integer( rzyre_encoder_t *enc, VALUE obj )
+{
+	const int negative = FIXNUM_P( obj ) ? FIX2LONG( obj ) < 0 :
+		FIX2INT( rb_big_cmp(obj, INT2FIX(0)) ) < 0;
+
+	if ( negative ) {
+		const int64_t value = NUM2LL( obj );
+
+		if ( value >= -32 )
+			rzyre_encoder_put( enc, (byte)value, 0, 0 );
+		else if ( value >= INT8_MIN )
+			rzyre_encoder_put( enc, 0xd0, value, 1 );
+		else if ( value >= INT16_MIN )
+			rzyre_encoder_put( enc, 0xd1, value, 2 );
+		else if ( value >= INT32_MIN )
+			rzyre_encoder_put( enc, 0xd2, value, 4 );
+		else
+			rzyre_encoder_put( enc, 0xd3, value, 8 );
+	} else {
+		const uint64_t value = NUM2ULL( obj );
+
+		if ( value <= 0x7f )
+			rzyre_encoder_put( enc, (byte)value, 0, 0 );
+		else if ( value <= UINT8_MAX )
+			rzyre_encoder_put( enc, 0xcc, value, 1 );
+		else if ( value <= UINT16_MAX )
+			rzyre_encoder_put( enc, 0xcd, value, 2 );
+		else if ( value <= UINT32_MAX )
+			rzyre_encoder_put( enc, 0xce, value, 4 );
+		else
+			rzyre_encoder_put( enc, 0xcf, value, 8 );
+	}
+}
+
+
+/*
+ * Append the given String, as binary data if it's binary, or as a string
+ * otherwise.
+ */
+static void
+rzyre_encode_string( rzyre_encoder_t *enc, VALUE obj )
+{
+	const size_t len = RSTRING_LEN( obj );
+
+	if ( ENCODING_GET(obj) == rb_ascii8bit_encindex() ) {
+		rzyre_encoder_put_header( enc, len, 0, 0, 0xc4, 0xc5 );
+	} else {
+		rzyre_encoder_put_header( enc, len, 0xa0, 32, 0xd9, 0xda );
+	}
+
+	rzyre_encoder_reserve( enc, len );
+	if ( enc->buf ) memcpy( enc->buf + enc->len, RSTRING_PTR(obj), len );
+	enc->len += len;
+}
+
+
+/*
+ * Append one pair of a Hash.
+ */
+static int
+rzyre_encode_hash_pair( VALUE key, VALUE val, VALUE encoder )
+{
+	rzyre_encoder_t *enc = (rzyre_encoder_t *)encoder;
+
+	rzyre_encode_object( enc, key );
+	rzyre_encode_object( enc, val );
+
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Append the given +obj+.
+ */
+static void
+rzyre_encode_object( rzyre_encoder_t *enc, VALUE obj )
+{
+	union { double d; uint64_t u; } bits;
+
+	if ( enc->depth > RZYRE_CODEC_MAX_DEPTH )
+		rb_raise( rb_eArgError, "too deeply nested to encode" );
+
+	switch ( TYPE(obj) ) {
+	  case T_NIL:
+		rzyre_encoder_put( enc, 0xc0, 0, 0 );
+		break;
+
+	  case T_FALSE:
+		rzyre_encoder_put( enc, 0xc2, 0, 0 );
+		break;
+
+	  case T_TRUE:
+		rzyre_encoder_put( enc, 0xc3, 0, 0 );
+		break;
+
+	  case T_FIXNUM:
+	  case T_BIGNUM:
+		rzyre_encode_integer( enc, obj );
+		break;
+
+	  case T_FLOAT:
+		bits.d = RFLOAT_VALUE( obj );
+		rzyre_encoder_put( enc, 0xcb, bits.u, 8 );
+		break;
+
+	  case T_SYMBOL:
+		rzyre_encode_string( enc, rb_sym2str(obj) );
+		break;
+
+	  case T_STRING:
+		rzyre_encode_string( enc, obj );
+		break;
+
+	  case T_ARRAY:
+		rzyre_encoder_put_header( enc, RARRAY_LEN(obj), 0x90, 16, 0, 0xdc );
+		enc->depth++;
+		for ( long i = 0 ; i < RARRAY_LEN(obj) ; i++ ) {
+			rzyre_encode_object( enc, RARRAY_AREF(obj, i) );
+		}
+		enc->depth--;
+		break;
+
+	  case T_HASH:
+		rzyre_encoder_put_header( enc, RHASH_SIZE(obj), 0x80, 16, 0, 0xde );
+		enc->depth++;
+		rb_hash_foreach( obj, rzyre_encode_hash_pair, (VALUE)enc );
+		enc->depth--;
+		break;
+
+	  default:
+		rb_raise( rb_eTypeError, "can't encode %s", rb_obj_classname(obj) );
+	}
+}
+
+
+// Struct for passing arguments through rb_ensure to rzyre_encode_body()
+typedef struct {
+	rzyre_encoder_t enc;
+	VALUE obj;
+	zframe_t *frame;
+	int done;
+} encode_call_t;
+
+
+static VALUE
+rzyre_encode_body( VALUE call_ptr )
+{
+	encode_call_t *call = (encode_call_t *)call_ptr;
+
+	rzyre_encode_object( &call->enc, call->obj );
+	call->done = TRUE;
+
+	return Qnil;
+}
+
+
+static VALUE
+rzyre_encode_ensure( VALUE call_ptr )
+{
+	encode_call_t *call = (encode_call_t *)call_ptr;
+
+	if ( call->done ) return Qnil;
+
+	if ( call->frame ) {
+		zframe_destroy( &call->frame );
+	} else if ( !call->enc.fixed ) {
+		free( call->enc.buf );
+	}
+
+	return Qnil;
+}
+
+
+/*
+ * Encode the given +obj+ into a buffer, returning the buffer (which the caller
+ * must free()) and setting +len+ to its length.
+ */
+static byte *
+rzyre_encode( VALUE obj, size_t *len )
+{
+	encode_call_t call = { { NULL, 0, 0, 0, FALSE }, obj, NULL, FALSE };
+
+	rb_ensure( rzyre_encode_body, (VALUE)&call, rzyre_encode_ensure, (VALUE)&call );
+
+	*len = call.enc.len;
+	return call.enc.buf;
+}
+
+
+/*
+ * Encode the given +obj+ as MessagePack directly into the memory of a new frame.
+ * The first pass only works out how big the encoding is, so the frame can be made
+ * at that size and the second pass can write into it without an intermediate
+ * buffer. Encoding doesn't call back into Ruby, so +obj+ can't change in between.
+ */
+zframe_t *
+rzyre_encode_frame( VALUE obj )
+{
+	encode_call_t call = { { NULL, 0, SIZE_MAX, 0, TRUE }, obj, NULL, FALSE };
+
+	rb_ensure( rzyre_encode_body, (VALUE)&call, rzyre_encode_ensure, (VALUE)&call );
+
+	call.frame = zframe_new( NULL, call.enc.len );
+	call.enc.buf = zframe_data( call.frame );
+	call.enc.capacity = call.enc.len;
+	call.enc.len = 0;
+	call.done = FALSE;
+
+	rb_ensure( rzyre_encode_body, (VALUE)&call, rzyre_encode_ensure, (VALUE)&call );
+
+	return call.frame;
+}
+
+
+/* --------------------------------------------------------------
+ * Decoding
+ * -------------------------------------------------------------- */
+
+// The state of a decoding
+typedef struct {
+	const byte *pos;
+	const byte *end;
+	int depth;
+} rzyre_decoder_t;
+
+
+/*
+ * Consume +size+ bytes, returning a pointer to the first of them.
+ */
+static const byte *
+rzyre_decoder_take( rzyre_decoder_t *dec, size_t size )
+{
+	const byte *pos = dec->pos;
+
+	if ( (size_t)(dec->end - dec->pos) < size )
+		rb_raise( rb_eArgError, "truncated MessagePack data" );
+	dec->pos += size;
+
+	return pos;
+}
+
+
+/*
+ * Consume a big-endian unsigned integer of +size+ bytes.
+ */
+static uint64_t
+rzyre_decoder_uint( rzyre_decoder_t *dec, int size )
+{
+	const byte *pos = rzyre_decoder_take( dec, size );
+	uint64_t value = 0;
+
+	for ( int i = 0 ; i < size ; i++ ) value = ( value << 8 ) | pos[i];
+
+	return value;
+}
+
+
+static VALUE rzyre_decode_object( rzyre_decoder_t *dec );
+
+
+/*
+ * Consume a String of +len+ bytes in the given +encoding+.
+ */
+static VALUE
+rzyre_decode_string( rzyre_decoder_t *dec, size_t len, rb_encoding *encoding )
+{
+	const byte *pos = rzyre_decoder_take( dec, len );
+
+	return rb_enc_str_new( (const char *)pos, len, encoding );
+}
+
+
+/*
+ * Consume an Array of +count+ elements.
+ */
+static VALUE
+rzyre_decode_array( rzyre_decoder_t *dec, size_t count )
+{
+	VALUE rval;
+
+	// Every element takes at least a byte, so don't preallocate more than that
+	rval = rb_ary_new_capa( count < (size_t)(dec->end - dec->pos) ? count : 0 );
+
+	dec->depth++;
+	while ( count-- > 0 ) rb_ary_push( rval, rzyre_decode_object(dec) );
+	dec->depth--;
+
+	return rval;
+}
+
+
+/*
+ * Consume a Hash of +count+ pairs.
+ */
+static VALUE
+rzyre_decode_hash( rzyre_decoder_t *dec, size_t count )
+{
+	VALUE rval = rb_hash_new();
+	VALUE key;
+
+	dec->depth++;
+	while ( count-- > 0 ) {
+		key = rzyre_decode_object( dec );
+		rb_hash_aset( rval, key, rzyre_decode_object(dec) );
+	}
+	dec->depth--;
+
+	return rval;
+}
+
+
+/*
+ * Consume the next object.
+ */
+static VALUE
+rzyre_decode_object( rzyre_decoder_t *dec )
+{
+	const byte tag = *rzyre_decoder_take( dec, 1 );
+	union { double d; uint64_t u; } bits;
+	union { float f; uint32_t u; } bits32;
+
+	if ( dec->depth > RZYRE_CODEC_MAX_DEPTH )
+		rb_raise( rb_eArgError, "MessagePack data too deeply nested" );
+
+	if ( tag <= 0x7f ) return INT2FIX( tag );
+	if ( tag >= 0xe0 ) return INT2FIX( (int8_t)tag );
+	if ( (tag & 0xf0) == 0x80 ) return rzyre_decode_hash( dec, tag & 0x0f );
+	if ( (tag & 0xf0) == 0x90 ) return rzyre_decode_array( dec, tag & 0x0f );
+	if ( (tag & 0xe0) == 0xa0 ) return rzyre_decode_string( dec, tag & 0x1f, rb_utf8_encoding() );
+
+	switch ( tag ) {
+	  case 0xc0: return Qnil;
+	  case 0xc2: return Qfalse;
+	  case 0xc3: return Qtrue;
+
+	  case 0xc4: return rzyre_decode_string( dec, rzyre_decoder_uint(dec, 1), rb_ascii8bit_encoding() );
+	  case 0xc5: return rzyre_decode_string( dec, rzyre_decoder_uint(dec, 2), rb_ascii8bit_encoding() );
+	  case 0xc6: return rzyre_decode_string( dec, rzyre_decoder_uint(dec, 4), rb_ascii8bit_encoding() );
+
+	  case 0xca:
+		bits32.u = (uint32_t)rzyre_decoder_uint( dec, 4 );
+		return DBL2NUM( bits32.f );
+	  case 0xcb:
+		bits.u = rzyre_decoder_uint( dec, 8 );
+		return DBL2NUM( bits.d );
+
+	  case 0xcc: return INT2FIX( rzyre_decoder_uint(dec, 1) );
+	  case 0xcd: return INT2FIX( rzyre_decoder_uint(dec, 2) );
+	  case 0xce: return ULONG2NUM( rzyre_decoder_uint(dec, 4) );
+	  case 0xcf: return ULL2NUM( rzyre_decoder_uint(dec, 8) );
+
+	  case 0xd0: return INT2FIX( (int8_t)rzyre_decoder_uint(dec, 1) );
+	  case 0xd1: return INT2FIX( (int16_t)rzyre_decoder_uint(dec, 2) );
+	  case 0xd2: return LONG2NUM( (int32_t)rzyre_decoder_uint(dec, 4) );
+	  case 0xd3: return LL2NUM( (int64_t)rzyre_decoder_uint(dec, 8) );
+
+	  case 0xd9: return rzyre_decode_string( dec, rzyre_decoder_uint(dec, 1), rb_utf8_encoding() );
+	  case 0xda: return rzyre_decode_string( dec, rzyre_decoder_uint(dec, 2), rb_utf8_encoding() );
+	  case 0xdb: return rzyre_decode_string( dec, rzyre_decoder_uint(dec, 4), rb_utf8_encoding() );
+
+	  case 0xdc: return rzyre_decode_array( dec, rzyre_decoder_uint(dec, 2) );
+	  case 0xdd: return rzyre_decode_array( dec, rzyre_decoder_uint(dec, 4) );
+	  case 0xde: return rzyre_decode_hash( dec, rzyre_decoder_uint(dec, 2) );
+	  case 0xdf: return rzyre_decode_hash( dec, rzyre_decoder_uint(dec, 4) );
+
+	  default:
+		rb_raise( rb_eArgError, "unsupported MessagePack type 0x%02x", tag );
+	}
+}
+
+
+/*
+ * Decode the MessagePack object in the +size+ bytes at +data+, which must contain
+ * exactly one object.
+ */
+VALUE
+rzyre_decode( const byte *data, size_t size )
+{
+	rzyre_decoder_t dec = { data, data + size, 0 };
+	VALUE rval = rzyre_decode_object( &dec );
+
+	if ( dec.pos != dec.end )
+		rb_raise( rb_eArgError, "%ld extra bytes after MessagePack data",
+			(long)(dec.end - dec.pos) );
+
+	return rval;
+}
+
+
+/* --------------------------------------------------------------
+ * Module methods
+ * -------------------------------------------------------------- */
+
+/*
+ * call-seq:
+ *    Zyre::Codec.encode( obj )   -> str
+ *
+ * Return the given +obj+ encoded as MessagePack in a binary String. Supports
+ * +nil+, +true+, +false+, Integers that fit in 64 bits, Floats, Strings (binary
+ * Strings are encoded as bin, others as str), Symbols (as str), and Arrays and
+ * Hashes of those.
+ *
+ */
+static VALUE
+rzyre_codec_s_encode( VALUE module, VALUE obj )
+{
+	size_t len;
+	byte *buf = rzyre_encode( obj, &len );
+	VALUE rval = rb_str_new( (const char *)buf, len );
+
+	free( buf );
+
+	return rval;
+}
+
+
+/*
+ * call-seq:
+ *    Zyre::Codec.decode( str )   -> obj
+ *
+ * Return the object encoded as MessagePack in the given String. Raises an
+ * ArgumentError if the String isn't a single valid MessagePack object of one of
+ * the supported types.
+ *
+ */
+static VALUE
+rzyre_codec_s_decode( VALUE module, VALUE data )
+{
+	StringValue( data );
+	return rzyre_decode( (const byte *)RSTRING_PTR(data), RSTRING_LEN(data) );
+}
+
+
+/*
+ * Initialize the Codec module.
+ */
+void
+rzyre_init_codec( void ) {
+
+#ifdef FOR_RDOC
+	rzyre_mZyre = rb_define_module( "Zyre" );
+#endif
+
+	/*
+	 * Document-module: Zyre::Codec
+	 *
+	 * A minimal MessagePack codec used by Zyre::Node#shout_encoded,
+	 * Zyre::Node#whisper_encoded, and Zyre::Event#decoded_msg to encode objects
+	 * straight into frames and decode them straight out of them.
+	 *
+	 * Refs:
+	 * - https://github.com/msgpack/msgpack/blob/master/spec.md
+	 *
+	 */
+	rzyre_mZyreCodec = rb_define_module_under( rzyre_mZyre, "Codec" );
+
+	rb_define_singleton_method( rzyre_mZyreCodec, "encode", rzyre_codec_s_encode, 1 );
+	rb_define_singleton_method( rzyre_mZyreCodec, "decode", rzyre_codec_s_decode, 1 );
+}
@@ -0,0 +1,275 @@
+/*
+ *  compression.c - Transparent compression of large message frames
+ *  $Id$
+ *
+ *  Authors:
+ *    * Michael Granger <ged@FaerieMUD.org>
+ *
+ */
+
+#include "zyre_ext.h"
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+# define RZYRE_HAVE_ZLIB 1
+# include <zlib.h>
+#endif
+
+
+#ifdef RZYRE_HAVE_ZLIB
+
+// Compressed frames start with this marker, followed by the uncompressed size as
+// a 32-bit big-endian integer, followed by the zlib stream.
+static const byte rzyre_compression_magic[] = { 0xff, 'Z', 'Z', 0x01 };
+#define RZYRE_COMPRESSION_MAGIC_SIZE 4
+#define RZYRE_COMPRESSION_HEADER_SIZE ( RZYRE_COMPRESSION_MAGIC_SIZE + 4 )
+
+// Uncompressed frames that would otherwise look like they start with a marker
+// are sent with this one in front of them, which the receiver strips off again.
+static const byte rzyre_compression_stored_magic[] = { 0xff, 'Z', 'Z', 0x00 };
+
+// The part of the markers that's common to both
+#define RZYRE_COMPRESSION_PREFIX_SIZE 3
+
+// zlib can't compress by more than this factor, so frames claiming to have been
+// are rejected rather than allocating a buffer for them
+#define RZYRE_COMPRESSION_MAX_RATIO 1032
+
+
+/*
+ * Return the CPU time used by the calling thread in nanoseconds.
+ */
+static uint64_t
+rzyre_thread_cpu_ns( void )
+{
+	struct timespec now;
+
+	clock_gettime( CLOCK_THREAD_CPUTIME_ID, &now );
+
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/*
+ * Return a new frame containing the +size+ bytes of +data+ with the given
+ * 4-byte +marker+ in front of them, or NULL if it couldn't be allocated.
+ */
+static zframe_t *
+rzyre_marked_frame( const byte *marker, const void *data, size_t size )
+{
+	zframe_t *frame = zframe_new( NULL, RZYRE_COMPRESSION_MAGIC_SIZE + size );
+
+	if ( !frame ) return NULL;
+
+	memcpy( zframe_data(frame), marker, RZYRE_COMPRESSION_MAGIC_SIZE );
+	memcpy( zframe_data(frame) + RZYRE_COMPRESSION_MAGIC_SIZE, data, size );
+
+	return frame;
+}
+
+
+/*
+ * Return a compressed copy of the given +frame+ if it's larger than +threshold+
+ * bytes and compressing it makes it smaller, adding to the +stats+ if it does.
+ * If it starts like a marker, return an escaped copy of it instead. Otherwise
+ * returns NULL, and the frame should be sent as it is.
+ */
+static zframe_t *
+rzyre_compress_frame( zframe_t *frame, size_t threshold, rzyre_compression_stats_t *stats )
+{
+	const size_t size = zframe_size( frame );
+	const byte *data = zframe_data( frame );
+	uLongf compressed_size = 0;
+	zframe_t *compressed = NULL;
+	byte *buf = NULL;
+
+	if ( size > threshold && size <= UINT32_MAX ) {
+		compressed_size = compressBound( size );
+		buf = malloc( RZYRE_COMPRESSION_HEADER_SIZE + compressed_size );
+	}
+
+	if ( buf && compress2(buf + RZYRE_COMPRESSION_HEADER_SIZE, &compressed_size, data,
+		size, Z_DEFAULT_COMPRESSION) == Z_OK &&
+		RZYRE_COMPRESSION_HEADER_SIZE + compressed_size < size )
+	{
+		memcpy( buf, rzyre_compression_magic, RZYRE_COMPRESSION_MAGIC_SIZE );
+		buf[4] = (byte)( size >> 24 );
+		buf[5] = (byte)( size >> 16 );
+		buf[6] = (byte)( size >> 8 );
+		buf[7] = (byte)size;
+
+		compressed = zframe_new( buf, RZYRE_COMPRESSION_HEADER_SIZE + compressed_size );
+	}
+
+	free( buf );
+
+	if ( compressed ) {
+		stats->frames++;
+		stats->raw_bytes += size;
+		stats->compressed_bytes += zframe_size( compressed );
+		return compressed;
+	}
+
+	if ( size >= RZYRE_COMPRESSION_PREFIX_SIZE &&
+		memcmp(data, rzyre_compression_magic, RZYRE_COMPRESSION_PREFIX_SIZE) == 0 )
+		return rzyre_marked_frame( rzyre_compression_stored_magic, data, size );
+
+	return NULL;
+}
+
+
+/*
+ * Return a decompressed copy of the given +frame+ if it was compressed by
+ * rzyre_compress_frame(), adding to the +stats+, or an unescaped copy of it if it
+ * was escaped. Otherwise returns NULL, and the frame should be kept as it is.
+ */
+static zframe_t *
+rzyre_decompress_frame( zframe_t *frame, rzyre_compression_stats_t *stats )
+{
+	const size_t size = zframe_size( frame );
+	const byte *data = zframe_data( frame );
+	uLongf raw_size;
+	zframe_t *decompressed;
+
+	if ( size >= RZYRE_COMPRESSION_MAGIC_SIZE &&
+		memcmp(data, rzyre_compression_stored_magic, RZYRE_COMPRESSION_MAGIC_SIZE) == 0 )
+		return zframe_new( data + RZYRE_COMPRESSION_MAGIC_SIZE, size - RZYRE_COMPRESSION_MAGIC_SIZE );
+
+	if ( size <= RZYRE_COMPRESSION_HEADER_SIZE ||
+		memcmp(data, rzyre_compression_magic, RZYRE_COMPRESSION_MAGIC_SIZE) != 0 )
+		return NULL;
+
+	raw_size = (uLongf)data[4] << 24 | (uLongf)data[5] << 16 | (uLongf)data[6] << 8 | data[7];
+	if ( raw_size / RZYRE_COMPRESSION_MAX_RATIO > size ) return NULL;
+	if ( !(decompressed = zframe_new(NULL, raw_size)) ) return NULL;
+
+	if ( uncompress(zframe_data(decompressed), &raw_size, data + RZYRE_COMPRESSION_HEADER_SIZE,
+		size - RZYRE_COMPRESSION_HEADER_SIZE) != Z_OK ||
+		raw_size != zframe_size(decompressed) )
+	{
+		zframe_destroy( &decompressed );
+		return NULL;
+	}
+
+	stats->frames++;
+	stats->raw_bytes += raw_size;
+	stats->compressed_bytes += size;
+
+	return decompressed;
+}
+
+
+/*
+ * Replace each frame of +msg+ with the one returned by calling +transform+ with
+ * it, if that returns one, keeping their order. Frames are replaced rather than
+ * reset because they might not own their data.
+ */
+static void
+rzyre_transform_msg( zmsg_t *msg, zframe_t *(*transform)(zframe_t *, void *), void *arg )
+{
+	const size_t count = zmsg_size( msg );
+	zframe_t *frame, *replacement;
+
+	for ( size_t i = 0 ; i < count ; i++ ) {
+		frame = zmsg_pop( msg );
+
+		if ( (replacement = transform(frame, arg)) ) {
+			zframe_destroy( &frame );
+			frame = replacement;
+		}
+
+		zmsg_append( msg, &frame );
+	}
+}
+
+
+// The arguments of a compression transform
+typedef struct {
+	size_t threshold;
+	rzyre_compression_stats_t *stats;
+} compress_frame_call_t;
+
+
+/*
+ * rzyre_transform_msg() callback for compressing frames.
+ */
+static zframe_t *
+rzyre_compress_frame_transform( zframe_t *frame, void *arg )
+{
+	compress_frame_call_t *call = (compress_frame_call_t *)arg;
+	return rzyre_compress_frame( frame, call->threshold, call->stats );
+}
+
+
+/*
+ * rzyre_transform_msg() callback for decompressing frames.
+ */
+static zframe_t *
+rzyre_decompress_frame_transform( zframe_t *frame, void *arg )
+{
+	return rzyre_decompress_frame( frame, (rzyre_compression_stats_t *)arg );
+}
+
+#endif
+
+
+/*
+ * Compress each frame of +msg+ that's larger than +threshold+ bytes, adding to the
+ * +stats+, and escape any that aren't compressed but start like a compressed frame
+ * would. Called without the GVL.
+ */
+void
+rzyre_compress_msg( zmsg_t *msg, size_t threshold, rzyre_compression_stats_t *stats )
+{
+#ifdef RZYRE_HAVE_ZLIB
+	const uint64_t start = rzyre_thread_cpu_ns();
+	compress_frame_call_t call = { threshold, stats };
+
+	rzyre_transform_msg( msg, rzyre_compress_frame_transform, &call );
+
+	stats->cpu_ns += rzyre_thread_cpu_ns() - start;
+#endif
+}
+
+
+/*
+ * Decompress each frame of +msg+ that was compressed by rzyre_compress_msg(),
+ * adding to the +stats+, and unescape any that it escaped. Called without the GVL.
+ */
+void
+rzyre_decompress_msg( zmsg_t *msg, rzyre_compression_stats_t *stats )
+{
+#ifdef RZYRE_HAVE_ZLIB
+	const uint64_t start = rzyre_thread_cpu_ns();
+
+	rzyre_transform_msg( msg, rzyre_decompress_frame_transform, stats );
+
+	stats->cpu_ns += rzyre_thread_cpu_ns() - start;
+#endif
+}
+
+
+/*
+ * Add the counts in the +src+ stats to the +dst+ stats.
+ */
+void
+rzyre_compression_stats_add( rzyre_compression_stats_t *dst, const rzyre_compression_stats_t *src )
+{
+	dst->frames += src->frames;
+	dst->raw_bytes += src->raw_bytes;
+	dst->compressed_bytes += src->compressed_bytes;
+	dst->cpu_ns += src->cpu_ns;
+}
+
+
+/*
+ * Return +true+ if the extension was built with zlib.
+ */
+int
+rzyre_compression_available( void )
+{
+#ifdef RZYRE_HAVE_ZLIB
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
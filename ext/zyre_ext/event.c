@@ -11,6 +11,44 @@
 
 VALUE rzyre_cZyreEvent;
 
+// Frames at least this big are returned as views of the frame's memory instead of
+// being copied
+#define RZYRE_FRAME_VIEW_MIN_SIZE 4096
+
+// The hidden ivar that keeps an event alive while a view of one of its frames exists
+static ID id_event;
+
+// The hidden ivar that caches an event's headers
+static ID id_headers;
+
+// The keyword arguments of Zyre::Event.synthesize
+static ID synthesize_keyword_ids[5];
+
+// ZRE event types, and the Zyre::Event subclasses that wrap them and the Symbols
+// returned by #type; these are looked up when the extension is loaded.
+typedef struct {
+	const char *type;
+	const char *class_name;
+	VALUE klass;
+	VALUE symbol;
+} rzyre_event_type_t;
+
+static rzyre_event_type_t rzyre_event_types[] = {
+	{ "ENTER",   "Enter",   Qnil, Qnil },
+	{ "EXIT",    "Exit",    Qnil, Qnil },
+	{ "JOIN",    "Join",    Qnil, Qnil },
+	{ "LEAVE",   "Leave",   Qnil, Qnil },
+	{ "EVASIVE", "Evasive", Qnil, Qnil },
+	{ "SILENT",  "Silent",  Qnil, Qnil },
+	{ "SHOUT",   "Shout",   Qnil, Qnil },
+	{ "WHISPER", "Whisper", Qnil, Qnil },
+	{ "STOP",    "Stop",    Qnil, Qnil },
+	{ NULL,      NULL,      Qnil, Qnil },
+};
+
+// The mask of the membership event types (ENTER, EXIT, JOIN, LEAVE, and STOP)
+unsigned int rzyre_membership_event_mask = 0;
+
 
 static void rzyre_event_free( void *ptr );
 
@@ -69,17 +107,284 @@ rzyre_get_event( VALUE self )
 
 
 /*
- * Async read function; called without the GVL.
+ * Return the entry in the event type table for the given +event_type+, or NULL if
+ * it's not a known type.
+ */
+static const rzyre_event_type_t *
+rzyre_event_type_entry( const char *event_type )
+{
+	const rzyre_event_type_t *entry;
+
+	for ( entry = rzyre_event_types ; entry->type ; entry++ ) {
+		if ( streq(entry->type, event_type) ) return entry;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Return the bit for the given +event_type+ in a mask of event types. Types that
+ * aren't in the type table all share the RZYRE_EVENT_TYPE_OTHER bit.
+ */
+unsigned int
+rzyre_event_type_bit( const char *event_type )
+{
+	const rzyre_event_type_t *entry = rzyre_event_type_entry( event_type );
+
+	return entry ? 1U << ( entry - rzyre_event_types ) : RZYRE_EVENT_TYPE_OTHER;
+}
+
+
+/*
+ * Return the bit for the event +type+ given as a name like :WHISPER or 'whisper',
+ * or as a Zyre::Event subclass. Raises an ArgumentError if it's not a known type.
+ */
+unsigned int
+rzyre_event_type_bit_from_value( VALUE type )
+{
+	const rzyre_event_type_t *entry = NULL;
+	VALUE name;
+
+	if ( RB_TYPE_P(type, T_CLASS) ) {
+		for ( entry = rzyre_event_types ; entry->type && entry->klass != type ; entry++ ) ;
+		if ( !entry->type ) entry = NULL;
+	} else {
+		name = rb_funcall( rb_obj_as_string(type), rb_intern("upcase"), 0 );
+		entry = rzyre_event_type_entry( StringValueCStr(name) );
+	}
+
+	if ( !entry )
+		rb_raise( rb_eArgError, "no such event type %+"PRIsVALUE, type );
+
+	return 1U << ( entry - rzyre_event_types );
+}
+
+
+/*
+ * Wrap the given +event+ in an instance of the appropriate Zyre::Event subclass.
+ */
+VALUE
+rzyre_wrap_event( VALUE klass, zyre_event_t *event )
+{
+	const char *event_type = zyre_event_type( event );
+	const rzyre_event_type_t *entry = rzyre_event_type_entry( event_type );
+	VALUE event_class = entry ? entry->klass : Qnil;
+	VALUE event_instance;
+
+	// Fall back to looking up types added to ZRE since this was written
+	if ( NIL_P(event_class) ) {
+		event_class = rb_funcall( klass, rb_intern("type_by_name"), 1,
+			rb_utf8_str_new_cstr(event_type) );
+		if ( NIL_P(event_class) ) event_class = klass;
+	}
+
+	event_instance = rb_obj_alloc( event_class );
+
+	RTYPEDDATA_DATA( event_instance ) = event;
+
+	return event_instance;
+}
+
+
+// Struct for passing arguments to rzyre_read_event_batch()
+typedef struct {
+	rzyre_node_data_t *node;
+	VALUE node_obj;
+	zyre_event_t **events;
+	unsigned char *observe_only;
+	long max;
+	int timeout;
+	long count;
+	long delivered;
+	rzyre_compression_stats_t stats;
+} read_event_batch_call_t;
+
+
+/*
+ * Async batch read function; called without the GVL. Waits up to the call's
+ * timeout for the node to become readable, then reads events until there are none
+ * left queued or the batch is full. Events that don't pass the node's filter are
+ * destroyed as they're read, and it keeps waiting if none of them did. Compressed
+ * frames are decompressed as they're read if the node has compression enabled.
  */
 static void *
-rzyre_read_event( void *node_ptr )
+rzyre_read_event_batch( void *batch_call )
+{
+	read_event_batch_call_t *call = (read_event_batch_call_t *)batch_call;
+	rzyre_node_data_t *node = call->node;
+	void *sock = zsock_resolve( zyre_socket(node->node) );
+	zmq_pollitem_t item = { sock, 0, ZMQ_POLLIN, 0 };
+	const int64_t deadline = zclock_mono() + call->timeout;
+	int timeout = call->timeout;
+	zyre_event_t *event;
+	zmsg_t *msg;
+	int filtered;
+
+	while ( zmq_poll(&item, 1, timeout) > 0 ) {
+		while ( call->count < call->max ) {
+			if ( !(event = zyre_event_new(node->node)) ) return NULL;
+
+			filtered = rzyre_filter_event( node, event );
+			if ( filtered == RZYRE_FILTER_DROP ) {
+				zyre_event_destroy( &event );
+			} else {
+				if ( filtered == RZYRE_FILTER_PASS ) {
+					if ( node->compression && (msg = zyre_event_msg(event)) )
+						rzyre_decompress_msg( msg, &call->stats );
+					call->delivered++;
+				}
+				call->observe_only[ call->count ] = ( filtered == RZYRE_FILTER_OBSERVE );
+				call->events[ call->count++ ] = event;
+			}
+
+			if ( !(zsock_events(sock) & ZMQ_POLLIN) ) break;
+		}
+
+		if ( call->count || timeout == 0 ) break;
+		if ( timeout > 0 && (timeout = deadline - zclock_mono()) <= 0 ) break;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Wait for the call's node to have input through the current Fiber scheduler, then
+ * read whatever is already queued without waiting any further. Returns Qfalse if
+ * the wait timed out.
+ */
+static VALUE
+rzyre_read_event_batch_in_fiber( VALUE batch_call )
 {
-	zyre_event_t *event_ptr;
-	assert( node_ptr );
+	read_event_batch_call_t *call = (read_event_batch_call_t *)batch_call;
+	const int timeout = call->timeout;
 
-	event_ptr = zyre_event_new( (zyre_t *)node_ptr );
-	assert( event_ptr );
-	return (void *)event_ptr;
+	if ( !rzyre_node_fiber_wait(call->node_obj, timeout) ) return Qfalse;
+
+	call->timeout = 0;
+	rzyre_read_event_batch( (void *)call );
+	call->timeout = timeout;
+
+	return Qtrue;
+}
+
+
+/*
+ * Read up to the call's max events from the given +node+ into the call, waiting up
+ * to its timeout for the first one. If the node has a background reader, the
+ * events come from it instead. Returns false if the wait timed out or was
+ * interrupted, and true if the node had input, even if none of it was kept.
+ */
+static int
+rzyre_read_event_batch_from_node( VALUE node, read_event_batch_call_t *call )
+{
+	rzyre_reader_t *reader = rzyre_node_reader( node );
+	const int timeout = call->timeout;
+	int observe_only, had_input;
+
+	if ( reader ) {
+		// With a background reader, wait for the first event to be buffered, then
+		// take whatever else is already in the buffer. Another thread can stop the
+		// reader while this one waits, so it's held until this one is done with it.
+		rzyre_reader_ref( reader );
+
+		if ( (had_input = rzyre_reader_wait(reader, timeout)) ) {
+			while ( call->count < call->max &&
+				(call->events[call->count] = rzyre_reader_pop(reader, &observe_only)) )
+			{
+				call->observe_only[ call->count++ ] = observe_only;
+				if ( !observe_only ) call->delivered++;
+			}
+		}
+
+		rzyre_reader_release( &reader );
+		return had_input;
+	} else if ( RZYRE_FIBER_SCHEDULER_P() ) {
+		// With a scheduler, wait for the first event in this fiber, then read
+		// whatever is already queued without waiting any further.
+		return RTEST( rzyre_nodes_polling(rb_ary_new_from_args(1, node),
+			rzyre_read_event_batch_in_fiber, (VALUE)call) );
+	} else {
+		// This keeps waiting until something passes the filter itself, so coming
+		// back empty-handed means it timed out or was interrupted. The node is
+		// counted as polled so a reader can't be started on it in the meantime.
+		call->node->polled++;
+		rb_thread_call_without_gvl2( rzyre_read_event_batch, (void *)call, RUBY_UBF_IO, 0 );
+		call->node->polled--;
+
+		return call->count > 0;
+	}
+}
+
+
+/*
+ * Read up to +max+ events from the given +node+, waiting up to +timeout+
+ * milliseconds (or indefinitely if +timeout+ is -1) for one that passes the node's
+ * filter. The events are wrapped in instances of +klass+; if +batch+ is an Array,
+ * they're pushed onto it and it's returned, otherwise the first one is returned,
+ * or nil if the timeout expired or the wait was interrupted. Events that were only
+ * read for the node's local directory are destroyed once it has seen them.
+ */
+static VALUE
+rzyre_read_events( VALUE klass, VALUE node, long max, int timeout, VALUE batch )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( node );
+	const int64_t deadline = zclock_mono() + timeout;
+	read_event_batch_call_t call;
+	VALUE rval = batch, event, events_buf, flags_buf;
+	int had_input;
+
+	call.node = ptr;
+	call.node_obj = node;
+	call.events = ALLOCV_N( zyre_event_t *, events_buf, max );
+	call.observe_only = ALLOCV_N( unsigned char, flags_buf, max );
+	call.max = max;
+	call.timeout = timeout;
+
+	do {
+		call.count = call.delivered = 0;
+		memset( &call.stats, 0, sizeof call.stats );
+
+		had_input = rzyre_read_event_batch_from_node( node, &call );
+		rzyre_compression_stats_add( &ptr->decompressed, &call.stats );
+
+		for ( long i = 0 ; i < call.count ; i++ ) {
+			rzyre_node_observe_event( node, call.events[i] );
+
+			if ( call.observe_only[i] ) {
+				zyre_event_destroy( &call.events[i] );
+			} else {
+				event = rzyre_wrap_event( klass, call.events[i] );
+				if ( NIL_P(batch) ) rval = event;
+				else rb_ary_push( batch, event );
+			}
+		}
+
+		// Keep waiting if everything that arrived was filtered out
+	} while ( had_input && !call.delivered && timeout != 0 &&
+		(timeout < 0 || (call.timeout = deadline - zclock_mono()) > 0) );
+
+	ALLOCV_END( flags_buf );
+	ALLOCV_END( events_buf );
+
+	return rval;
+}
+
+
+/*
+ * Read the next event from the given +node+, waiting up to +timeout+ milliseconds
+ * for it to arrive (or indefinitely if +timeout+ is -1). Waiting for and reading
+ * the event happen in the same GVL-free section (or via the Fiber scheduler if
+ * there is one). If the node has a background reader, the event comes from it
+ * instead. Events that don't pass the node's filter are skipped. Returns the
+ * event wrapped in a Zyre::Event, or nil if the timeout expired or the wait was
+ * interrupted.
+ */
+VALUE
+rzyre_read_event_from_node( VALUE node, int timeout )
+{
+	return rzyre_read_events( rzyre_cZyreEvent, node, 1, timeout, Qnil );
 }
 
 
@@ -87,31 +392,46 @@ rzyre_read_event( void *node_ptr )
  * call-seq:
  *    Zyre::Event.from_node( node )   -> event
  *
- * Read the next event from the given Zyre::Node and wrap it in a Zyre::Event.
+ * Read the next event from the given Zyre::Node and wrap it in a Zyre::Event. If
+ * there is a Fiber scheduler active, only the current fiber waits for the event.
  *
  */
 static VALUE
 rzyre_event_s_from_node( VALUE klass, VALUE node )
 {
-	zyre_t *node_ptr = rzyre_get_node( node );
-	zyre_event_t *event;
+	return rzyre_read_event_from_node( node, -1 );
+}
 
-	assert( node_ptr );
 
-	event = rb_thread_call_without_gvl2( rzyre_read_event, (void *)node_ptr, RUBY_UBF_IO, 0 );
+/*
+ * call-seq:
+ *    Zyre::Event.batch_from_node( node, max, timeout=-1 )   -> array
+ *
+ * Wait up to +timeout+ seconds for an event from the given Zyre::Node, then read up
+ * to +max+ of the events which are already waiting, all without reacquiring the
+ * GVL in between. Returns the events wrapped in Zyre::Events, or an empty Array
+ * if the timeout expires first. A +timeout+ of -1 means wait indefinitely. If
+ * there is a Fiber scheduler active, only the current fiber waits.
+ *
+ */
+static VALUE
+rzyre_event_s_batch_from_node( int argc, VALUE *argv, VALUE klass )
+{
+	VALUE node, max_arg, timeout_arg;
+	long max;
+	int timeout = -1;
+
+	rb_scan_args( argc, argv, "21", &node, &max_arg, &timeout_arg );
 
-	if ( event ) {
-		const char *event_type = zyre_event_type( event );
-		VALUE event_type_s = rb_utf8_str_new_cstr( event_type );
-		VALUE event_class = rb_funcall( klass, rb_intern("type_by_name"), 1, event_type_s );
-		VALUE event_instance = rb_class_new_instance( 0, NULL, event_class );
+	rzyre_get_node_data( node );
+	max = NUM2LONG( max_arg );
 
-		RTYPEDDATA_DATA( event_instance ) = event;
+	if ( max < 1 )
+		rb_raise( rb_eArgError, "batch size must be at least 1" );
+	if ( !NIL_P(timeout_arg) && NUM2DBL(timeout_arg) >= 0 )
+		timeout = floor( NUM2DBL(timeout_arg) * 1000 );
 
-		return event_instance;
-	} else {
-		return Qnil;
-	}
+	return rzyre_read_events( klass, node, max, timeout, rb_ary_new() );
 }
 
 
@@ -185,27 +505,20 @@ rzyre_event_s_synthesize( int argc, VALUE *argv, VALUE klass )
 {
 	VALUE rval, event_type, peer_uuid, kwargs, event_class;
 	VALUE kwvals[5] = { Qundef, Qundef, Qundef, Qundef, Qundef };
-	static ID keyword_ids[5];
 	zyre_event_t *ptr = NULL;
 
 	// Parse the arguments + keyword arguments
-	if ( !keyword_ids[0] ) {
-		CONST_ID( keyword_ids[0], "peer_name" );
-		CONST_ID( keyword_ids[1], "headers" );
-		CONST_ID( keyword_ids[2], "peer_addr" );
-		CONST_ID( keyword_ids[3], "group" );
-		CONST_ID( keyword_ids[4], "msg" );
-	}
-
 	rzyre_log( "debug", "Scanning %d synthesize args.", argc );
 	rb_scan_args( argc, argv, "2:", &event_type, &peer_uuid, &kwargs );
 	if ( RTEST(kwargs) ) {
-		rzyre_log( "debug", "  scanning keyword args: %s", RSTRING_PTR(rb_inspect(kwargs)) );
-		rb_get_kwargs( kwargs, keyword_ids, 0, 5, kwvals );
+		if ( rzyre_log_enabled("debug") )
+			rzyre_log( "debug", "  scanning keyword args: %s", RSTRING_PTR(rb_inspect(kwargs)) );
+		rb_get_kwargs( kwargs, synthesize_keyword_ids, 0, 5, kwvals );
 	}
 
 	// Translate the event type argument into the appropriate class and instantiate it
-	rzyre_log( "debug", "Creating an instance of a %s event.", RSTRING_PTR(rb_inspect(event_type )) );
+	if ( rzyre_log_enabled("debug") )
+		rzyre_log( "debug", "Creating an instance of a %s event.", RSTRING_PTR(rb_inspect(event_type)) );
 	event_class = rb_funcall( klass, rb_intern("type_by_name"), 1, event_type );
 
 	if ( RTEST(event_class) ) {
@@ -250,18 +563,20 @@ rzyre_event_s_synthesize( int argc, VALUE *argv, VALUE klass )
 		if ( RB_TYPE_P(kwvals[4], T_UNDEF) )
 			rb_raise( rb_eArgError, "missing required field :msg" );
 
-		rzyre_log( "debug", "Making a WHISPER zmsg from the :msg value: %s",
-			RSTRING_PTR(rb_inspect(kwvals[4])) );
-		ptr->msg = rzyre_make_zmsg_from( kwvals[4] );
+		if ( rzyre_log_enabled("debug") )
+			rzyre_log( "debug", "Making a WHISPER zmsg from the :msg value: %s",
+				RSTRING_PTR(rb_inspect(kwvals[4])) );
+		ptr->msg = rzyre_make_zmsg_from( kwvals[4], FALSE );
 	}
 	else if ( streq(ptr->type, "SHOUT") ) {
 		if ( RB_TYPE_P(kwvals[4], T_UNDEF) )
 			rb_raise( rb_eArgError, "missing required field :msg" );
 
-		rzyre_log( "debug", "Making a SHOUT zmsg from the :msg value: %s",
-			RSTRING_PTR(rb_inspect(kwvals[4])) );
+		if ( rzyre_log_enabled("debug") )
+			rzyre_log( "debug", "Making a SHOUT zmsg from the :msg value: %s",
+				RSTRING_PTR(rb_inspect(kwvals[4])) );
 		ptr->group = rzyre_copy_required_string( kwvals[3], "group" );
-		ptr->msg = rzyre_make_zmsg_from( kwvals[4] );
+		ptr->msg = rzyre_make_zmsg_from( kwvals[4], FALSE );
 	}
 
 	rzyre_log_obj( rval, "debug", "Synthesized a %s event.", ptr->type );
@@ -284,9 +599,13 @@ rzyre_event_type( VALUE self )
 {
 	zyre_event_t *ptr = rzyre_get_event( self );
 	const char *type_str = zyre_event_type( ptr );
-	const VALUE type = rb_str_new2( type_str );
+	const rzyre_event_type_t *entry = rzyre_event_type_entry( type_str );
 
-	return rb_to_symbol( type );
+	if ( entry ) {
+		return entry->symbol;
+	} else {
+		return rb_to_symbol( rb_str_new2(type_str) );
+	}
 }
 
 
@@ -294,14 +613,14 @@ rzyre_event_type( VALUE self )
  * call-seq:
  *    event.peer_uuid   -> str
  *
- * Return the sending peer's uuid as a string
+ * Return the sending peer's uuid as a (frozen, deduplicated) string
  */
 static VALUE
 rzyre_event_peer_uuid( VALUE self ) {
 	zyre_event_t *ptr = rzyre_get_event( self );
 	const char *uuid_str = zyre_event_peer_uuid( ptr );
 
-	return rb_str_new2( uuid_str );
+	return rzyre_interned_str( uuid_str );
 }
 
 
@@ -309,14 +628,14 @@ rzyre_event_peer_uuid( VALUE self ) {
  * call-seq:
  *    event.peer_name
  *
- * Return the sending peer's public name as a string
+ * Return the sending peer's public name as a (frozen, deduplicated) string
  */
 static VALUE
 rzyre_event_peer_name( VALUE self ) {
 	zyre_event_t *ptr = rzyre_get_event( self );
 	const char *name_str = zyre_event_peer_name( ptr );
 
-	return rb_str_new2( name_str );
+	return rzyre_interned_str( name_str );
 }
 
 
@@ -344,22 +663,18 @@ rzyre_event_peer_addr( VALUE self ) {
  * call-seq:
  *    event.event_headers
  *
- * Returns the event headers, or NULL if there are none
+ * Returns the event headers as a frozen Hash, which is empty if there are none.
+ * The Hash is built the first time it's asked for, and its names and values are
+ * deduplicated across events.
  */
 static VALUE
 rzyre_event_headers( VALUE self ) {
 	zyre_event_t *ptr = rzyre_get_event( self );
-	zhash_t *headers = zyre_event_headers( ptr );
-	VALUE rhash = rb_hash_new();
-	const char *key, *val;
-
-	if ( headers ) {
-		val = (const char *)zhash_first( headers );
-		while( val ) {
-			key = zhash_cursor( headers );
-			rb_hash_aset( rhash, rb_str_new2(key), rb_str_new2(val) );
-			val = (const char *)zhash_next( headers );
-		}
+	VALUE rhash = rb_attr_get( self, id_headers );
+
+	if ( NIL_P(rhash) ) {
+		rhash = rzyre_frozen_hash_from_zhash( zyre_event_headers(ptr) );
+		rb_ivar_set( self, id_headers, rhash );
 	}
 
 	return rhash;
@@ -391,7 +706,8 @@ rzyre_event_header( VALUE self, VALUE name ) {
  * call-seq:
  *    event.event_group
  *
- * Returns the group name that a SHOUT event was sent to
+ * Returns the group name that a SHOUT event was sent to, as a (frozen,
+ * deduplicated) string
  */
 static VALUE
 rzyre_event_group( VALUE self ) {
@@ -399,7 +715,7 @@ rzyre_event_group( VALUE self ) {
 	const char *group_str = zyre_event_group( ptr );
 
 	if ( group_str ) {
-		return rb_str_new2( group_str );
+		return rzyre_interned_str( group_str );
 	} else {
 		return Qnil;
 	}
@@ -429,11 +745,40 @@ rzyre_event_msg_size( VALUE self )
 }
 
 
+/*
+ * Return the data in the specified +frame+ of the given +event+ as a frozen binary
+ * String. Small frames are copied; larger ones are returned as a String that
+ * points directly at the frame's memory. The String is shared with a hidden root
+ * String which refers to the event, so the frame can't be freed while the String
+ * (or any String which shares its buffer) is still reachable.
+ */
+static VALUE
+rzyre_frame_data( VALUE event, zframe_t *frame )
+{
+	const char *data = (const char *)zframe_data( frame );
+	const size_t size = zframe_size( frame );
+	VALUE root, rval;
+
+	if ( size < RZYRE_FRAME_VIEW_MIN_SIZE ) {
+		rval = rb_enc_str_new( data, size, rb_ascii8bit_encoding() );
+	} else {
+		root = rb_enc_str_new_static( data, size, rb_ascii8bit_encoding() );
+		rb_ivar_set( root, id_event, event );
+		rb_obj_freeze( root );
+
+		rval = rb_str_new_shared( root );
+	}
+
+	return rb_obj_freeze( rval );
+}
+
+
 /*
  * call-seq:
  *    event.msg
  *
- * Returns the data from the first frame of the message from the receiver.
+ * Returns the data from the first frame of the message from the receiver. Large
+ * frames are not copied; the returned String refers to the event's memory.
  */
 static VALUE
 rzyre_event_msg( VALUE self ) {
@@ -443,12 +788,7 @@ rzyre_event_msg( VALUE self ) {
 
 	if ( msg ) {
 		zframe_t *frame = zmsg_first( msg );
-		char *str = zframe_strdup( frame );
-
-		rval = rb_enc_str_new( str, zframe_size(frame), rb_ascii8bit_encoding() );
-		rb_obj_freeze( rval );
-
-		free( str );
+		rval = rzyre_frame_data( self, frame );
 	}
 
 	return rval;
@@ -459,7 +799,8 @@ rzyre_event_msg( VALUE self ) {
  * call-seq:
  *    event.multipart_msg
  *
- * Returns the data from every frame of the message from the receiver.
+ * Returns the data from every frame of the message from the receiver. Large
+ * frames are not copied; the returned Strings refer to the event's memory.
  */
 static VALUE
 rzyre_event_multipart_msg( VALUE self ) {
@@ -471,13 +812,7 @@ rzyre_event_multipart_msg( VALUE self ) {
 		zframe_t *frame = zmsg_first( msg );
 
 		while ( frame ) {
-			char *str = zframe_strdup( frame );
-			VALUE data = rb_enc_str_new( str, zframe_size(frame), rb_ascii8bit_encoding() );
-
-			rb_obj_freeze( data );
-			rb_ary_push( rval, data );
-
-			free( str );
+			rb_ary_push( rval, rzyre_frame_data(self, frame) );
 			frame = zmsg_next( msg );
 		}
 	}
@@ -486,6 +821,119 @@ rzyre_event_multipart_msg( VALUE self ) {
 }
 
 
+/*
+ * call-seq:
+ *    event.decoded_msg   -> obj
+ *
+ * Returns the object encoded as MessagePack in the first frame of the message from
+ * the receiver (e.g., by Zyre::Node#shout_encoded), decoded directly from the
+ * frame's memory. Returns +nil+ if the event has no message, and raises an
+ * ArgumentError if the frame isn't valid MessagePack.
+ */
+static VALUE
+rzyre_event_decoded_msg( VALUE self ) {
+	zmsg_t *msg = zyre_event_msg( rzyre_get_event(self) );
+	zframe_t *frame;
+
+	if ( !msg || !(frame = zmsg_first(msg)) ) return Qnil;
+
+	return rzyre_decode( zframe_data(frame), zframe_size(frame) );
+}
+
+
+/*
+ * Return the frame at +index+ of the given +event+'s message, or NULL if it
+ * doesn't have a message or has no frame at that index. Negative indexes count
+ * back from the last frame.
+ */
+static zframe_t *
+rzyre_event_frame_at( VALUE event, VALUE index )
+{
+	zmsg_t *msg = zyre_event_msg( rzyre_get_event(event) );
+	long i = NUM2LONG( index );
+	zframe_t *frame;
+
+	if ( !msg ) return NULL;
+
+	if ( i < 0 ) i += zmsg_size( msg );
+	if ( i < 0 || (size_t)i >= zmsg_size(msg) ) return NULL;
+
+	frame = zmsg_first( msg );
+	while ( i-- > 0 ) frame = zmsg_next( msg );
+
+	return frame;
+}
+
+
+/*
+ * call-seq:
+ *    event.each_frame {|data| ... }   -> event
+ *    event.each_frame                 -> enumerator
+ *
+ * Yield the data from each frame of the message from the receiver in turn, without
+ * building an Array of them first. Large frames are not copied; the yielded
+ * Strings refer to the event's memory. If no block is given, returns an
+ * Enumerator.
+ */
+static VALUE
+rzyre_event_each_frame( VALUE self ) {
+	zmsg_t *msg = zyre_event_msg( rzyre_get_event(self) );
+	zframe_t **frames;
+	zframe_t *frame;
+	VALUE tmpbuf;
+	size_t count = 0;
+
+	RETURN_ENUMERATOR( self, 0, 0 );
+
+	if ( !msg ) return self;
+
+	// Collect the frames first, since the block could move the message's cursor
+	frames = ALLOCV_N( zframe_t *, tmpbuf, zmsg_size(msg) );
+	for ( frame = zmsg_first(msg) ; frame ; frame = zmsg_next(msg) ) {
+		frames[ count++ ] = frame;
+	}
+
+	for ( size_t i = 0 ; i < count ; i++ ) {
+		rb_yield( rzyre_frame_data(self, frames[i]) );
+	}
+
+	ALLOCV_END( tmpbuf );
+
+	return self;
+}
+
+
+/*
+ * call-seq:
+ *    event.frame( index )   -> str or nil
+ *
+ * Returns the data from the frame at +index+ of the message from the receiver, or
+ * +nil+ if there's no such frame. Negative indexes count back from the last frame.
+ * Only the requested frame is copied (and only if it's small).
+ */
+static VALUE
+rzyre_event_frame( VALUE self, VALUE index ) {
+	zframe_t *frame = rzyre_event_frame_at( self, index );
+
+	return frame ? rzyre_frame_data( self, frame ) : Qnil;
+}
+
+
+/*
+ * call-seq:
+ *    event.frame_size( index )   -> int or nil
+ *
+ * Returns the size in bytes of the frame at +index+ of the message from the
+ * receiver without copying it, or +nil+ if there's no such frame.
+ */
+static VALUE
+rzyre_event_frame_size( VALUE self, VALUE index ) {
+	zframe_t *frame = rzyre_event_frame_at( self, index );
+
+	return frame ? SIZET2NUM( zframe_size(frame) ) : Qnil;
+}
+
+
 /*
  * call-seq:
  *    event.print
@@ -507,6 +955,7 @@ rzyre_event_print( VALUE self ) {
  */
 void
 rzyre_init_event( void ) {
+	rzyre_event_type_t *entry;
 
 #ifdef FOR_RDOC
 	rb_cData = rb_define_class( "Data" );
@@ -525,7 +974,18 @@ rzyre_init_event( void ) {
 
 	rb_define_alloc_func( rzyre_cZyreEvent, rzyre_event_alloc );
 
+	id_event = rb_intern( "__event__" );
+	id_headers = rb_intern( "__headers__" );
+
+	synthesize_keyword_ids[0] = rb_intern( "peer_name" );
+	synthesize_keyword_ids[1] = rb_intern( "headers" );
+	synthesize_keyword_ids[2] = rb_intern( "peer_addr" );
+	synthesize_keyword_ids[3] = rb_intern( "group" );
+	synthesize_keyword_ids[4] = rb_intern( "msg" );
+
 	rb_define_singleton_method( rzyre_cZyreEvent, "from_node", rzyre_event_s_from_node, 1 );
+	rb_define_singleton_method( rzyre_cZyreEvent, "batch_from_node",
+		rzyre_event_s_batch_from_node, -1 );
 	rb_define_singleton_method( rzyre_cZyreEvent, "synthesize", rzyre_event_s_synthesize, -1 );
 
 	rb_define_method( rzyre_cZyreEvent, "type", rzyre_event_type, 0 );
@@ -538,8 +998,21 @@ rzyre_init_event( void ) {
 	rb_define_method( rzyre_cZyreEvent, "msg_size", rzyre_event_msg_size, 0 );
 	rb_define_method( rzyre_cZyreEvent, "msg", rzyre_event_msg, 0 );
 	rb_define_method( rzyre_cZyreEvent, "multipart_msg", rzyre_event_multipart_msg, 0 );
+	rb_define_method( rzyre_cZyreEvent, "decoded_msg", rzyre_event_decoded_msg, 0 );
+	rb_define_method( rzyre_cZyreEvent, "each_frame", rzyre_event_each_frame, 0 );
+	rb_define_method( rzyre_cZyreEvent, "frame", rzyre_event_frame, 1 );
+	rb_define_method( rzyre_cZyreEvent, "frame_size", rzyre_event_frame_size, 1 );
 	rb_define_method( rzyre_cZyreEvent, "print", rzyre_event_print, 0 );
 
 	rb_require( "zyre/event" );
+
+	for ( entry = rzyre_event_types ; entry->type ; entry++ ) {
+		entry->klass = rb_const_get( rzyre_cZyreEvent, rb_intern(entry->class_name) );
+		entry->symbol = ID2SYM( rb_intern(entry->type) );
+		rb_gc_register_mark_object( entry->klass );
+	}
+
+	rzyre_membership_event_mask = rzyre_event_type_bit( "ENTER" ) | rzyre_event_type_bit( "EXIT" ) |
+		rzyre_event_type_bit( "JOIN" ) | rzyre_event_type_bit( "LEAVE" ) | rzyre_event_type_bit( "STOP" );
 }
 
@@ -16,10 +16,23 @@ have_header( 'czmq.h' ) or
 	abort "No czmq.h header!"
 have_header( 'ruby/thread.h' ) or
 	abort "Your Ruby is too old!"
+have_header( 'stdatomic.h' ) or
+	abort "No stdatomic.h header; a C11 compiler is required!"
 
 have_func( 'zyre_set_name', 'zyre.h' )
 have_func( 'zyre_set_silent_timeout', 'zyre.h' )
 
+have_header( 'zlib.h' ) && have_library( 'z', 'compress2' )
+
+have_header( 'ruby/fiber/scheduler.h' )
+have_func( 'rb_fiber_scheduler_current', 'ruby/fiber/scheduler.h' )
+have_func( 'rb_io_wait', 'ruby.h' )
+have_func( 'rb_enc_interned_str_cstr', 'ruby/encoding.h' )
+
+have_header( 'ruby/ractor.h' )
+have_func( 'rb_ext_ractor_safe', 'ruby.h' )
+have_func( 'rb_ractor_local_storage_ptr_newkey', 'ruby/ractor.h' )
+
 create_header()
 create_makefile( 'zyre_ext' )
 
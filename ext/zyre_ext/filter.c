@@ -0,0 +1,154 @@
+/*
+ *  filter.c - Filtering of a node's events before they're wrapped
+ *  $Id$
+ *
+ *  Authors:
+ *    * Michael Granger <ged@FaerieMUD.org>
+ *
+ */
+
+#include "zyre_ext.h"
+
+
+// A node's event filter. Filters are built with the GVL and never changed after
+// that; they're applied without the GVL by whatever is reading the node's events,
+// under the node's filter mutex. The node's pointer to its filter is only read or
+// replaced under that mutex, too.
+struct rzyre_event_filter {
+	unsigned int types;     //  The mask of the event types to pass
+	zhash_t *allow_peers;   //  If set, only pass events from these peers
+	zhash_t *deny_peers;    //  If set, don't pass events from these peers
+	zhash_t *groups;        //  If set, only pass events for these groups
+};
+
+// The value of the items in the filter's sets
+static char rzyre_filter_member[] = "";
+
+
+/*
+ * Return a set of the Strings in the given +members+ Array, or NULL if it's nil.
+ */
+static zhash_t *
+rzyre_filter_set( VALUE members )
+{
+	zhash_t *set;
+	VALUE member;
+
+	if ( NIL_P(members) ) return NULL;
+
+	set = zhash_new();
+	for ( long i = 0 ; i < RARRAY_LEN(members) ; i++ ) {
+		member = RARRAY_AREF( members, i );
+		zhash_insert( set, StringValueCStr(member), rzyre_filter_member );
+	}
+
+	return set;
+}
+
+
+/*
+ * Create a filter that passes events of the +types+ in the given mask. The peer
+ * and group sets are each nil or an Array of Strings, which should already have
+ * been checked.
+ */
+rzyre_event_filter_t *
+rzyre_filter_new( unsigned int types, VALUE allow_peers, VALUE deny_peers, VALUE groups )
+{
+	rzyre_event_filter_t *filter = (rzyre_event_filter_t *) zmalloc( sizeof *filter );
+
+	filter->types = types;
+	filter->allow_peers = rzyre_filter_set( allow_peers );
+	filter->deny_peers = rzyre_filter_set( deny_peers );
+	filter->groups = rzyre_filter_set( groups );
+
+	return filter;
+}
+
+
+/*
+ * Free the filter pointed to by +filter_ptr+.
+ */
+void
+rzyre_filter_destroy( rzyre_event_filter_t **filter_ptr )
+{
+	rzyre_event_filter_t *filter = *filter_ptr;
+
+	if ( !filter ) return;
+
+	zhash_destroy( &filter->allow_peers );
+	zhash_destroy( &filter->deny_peers );
+	zhash_destroy( &filter->groups );
+	free( filter );
+
+	*filter_ptr = NULL;
+}
+
+
+/*
+ * Apply the filter of the given +node+ (if it has one) to the +event+, counting it
+ * if it's dropped. Peer sets don't apply to STOP events, which come from the node
+ * itself, and the group set only applies to events that have a group. Events that
+ * don't pass but that the node's local directory needs to see are returned as
+ * RZYRE_FILTER_OBSERVE instead of RZYRE_FILTER_DROP. Doesn't need the GVL.
+ */
+int
+rzyre_filter_event( rzyre_node_data_t *node, zyre_event_t *event )
+{
+	rzyre_event_filter_t *filter;
+	const char *type, *peer_uuid, *group;
+	unsigned int bit = 0;
+	int rval = RZYRE_FILTER_PASS;
+
+	pthread_mutex_lock( &node->filter_mutex );
+
+	if ( (filter = node->filter) ) {
+		type = zyre_event_type( event );
+		peer_uuid = zyre_event_peer_uuid( event );
+		group = zyre_event_group( event );
+		bit = rzyre_event_type_bit( type );
+
+		if ( !(filter->types & bit) ) {
+			node->filtered.types++;
+			rval = RZYRE_FILTER_DROP;
+		}
+		else if ( peer_uuid && !streq(type, "STOP") &&
+			((filter->allow_peers && !zhash_lookup(filter->allow_peers, peer_uuid)) ||
+			 (filter->deny_peers && zhash_lookup(filter->deny_peers, peer_uuid))) )
+		{
+			node->filtered.peers++;
+			rval = RZYRE_FILTER_DROP;
+		}
+		else if ( group && filter->groups && !zhash_lookup(filter->groups, group) ) {
+			node->filtered.groups++;
+			rval = RZYRE_FILTER_DROP;
+		}
+	}
+
+	if ( rval == RZYRE_FILTER_DROP && node->observing && (bit & rzyre_membership_event_mask) )
+		rval = RZYRE_FILTER_OBSERVE;
+
+	pthread_mutex_unlock( &node->filter_mutex );
+
+	return rval;
+}
+
+
+/*
+ * Returns true if the local directory of the given +node+ needs to see events of
+ * the type with the given +bit+. Doesn't need the GVL, and doesn't touch the
+ * directory itself, which can be freed by a thread that holds it.
+ */
+int
+rzyre_filter_observes( rzyre_node_data_t *node, unsigned int bit )
+{
+	int rval;
+
+	if ( !(bit & rzyre_membership_event_mask) ) return FALSE;
+
+	pthread_mutex_lock( &node->filter_mutex );
+	rval = node->observing;
+	pthread_mutex_unlock( &node->filter_mutex );
+
+	return rval;
+}
+
@@ -0,0 +1,356 @@
+/*
+ *  log_bridge.c - Forward czmq/zyre logging to Loggability
+ *  $Id$
+ *
+ *  Authors:
+ *    * Michael Granger <ged@FaerieMUD.org>
+ *
+ */
+
+#include "zyre_ext.h"
+
+#define RZYRE_LOG_BRIDGE_ENDPOINT "inproc://rzyre-log-bridge"
+
+VALUE rzyre_mZyreLogBridge;
+
+
+// The state of the bridge; the ring of log lines is shared between the consumer
+// actor, which fills it, and the Ruby thread that drains it.
+struct rzyre_log_bridge {
+	zactor_t *actor;        //  The consumer reading from the zsys log socket
+	char **lines;           //  Ring of log lines waiting to be drained
+	size_t capacity;        //  The size of the ring
+	size_t head;            //  The index of the oldest line in the ring
+	size_t count;           //  The number of lines in the ring
+	unsigned long drops;    //  Lines dropped because the ring was full
+	int running;            //  True while zsys logging is routed to the bridge
+	int interrupted;        //  Set by the unblocking function to wake a drain
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+static struct rzyre_log_bridge rzyre_log_bridge = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+
+/*
+ * Add a +line+ to the ring, taking ownership of it. If the ring is full, the line
+ * is dropped instead so the logging threads are never held up.
+ */
+static void
+rzyre_log_bridge_push( char *line )
+{
+	struct rzyre_log_bridge *bridge = &rzyre_log_bridge;
+
+	pthread_mutex_lock( &bridge->mutex );
+
+	if ( bridge->count == bridge->capacity ) {
+		bridge->drops++;
+		zstr_free( &line );
+	} else {
+		bridge->lines[ (bridge->head + bridge->count) % bridge->capacity ] = line;
+		bridge->count++;
+		pthread_cond_signal( &bridge->cond );
+	}
+
+	pthread_mutex_unlock( &bridge->mutex );
+}
+
+
+/*
+ * Free any lines left in the ring, and the ring itself. Called with the mutex held.
+ */
+static void
+rzyre_log_bridge_clear( struct rzyre_log_bridge *bridge )
+{
+	while ( bridge->count ) {
+		zstr_free( &bridge->lines[bridge->head] );
+		bridge->head = ( bridge->head + 1 ) % bridge->capacity;
+		bridge->count--;
+	}
+
+	free( bridge->lines );
+	bridge->lines = NULL;
+	bridge->capacity = bridge->head = 0;
+}
+
+
+/*
+ * The consumer actor; subscribes to everything zsys logs and pushes it onto the
+ * ring until it's told to terminate.
+ */
+static void
+rzyre_log_bridge_actor( zsock_t *pipe, void *args )
+{
+	zsock_t *sub = zsock_new_sub( RZYRE_LOG_BRIDGE_ENDPOINT, "" );
+	zpoller_t *poller = zpoller_new( pipe, sub, NULL );
+	void *which;
+	char *line;
+
+	zsock_signal( pipe, 0 );
+
+	while ( (which = zpoller_wait(poller, -1)) ) {
+		line = zstr_recv( which );
+
+		if ( which == pipe ) {
+			zstr_free( &line );
+			break;
+		}
+		else if ( line ) {
+			rzyre_log_bridge_push( line );
+		}
+	}
+
+	zpoller_destroy( &poller );
+	zsock_destroy( &sub );
+}
+
+
+// Struct for passing arguments to rzyre_log_bridge_drain_without_gvl()
+typedef struct {
+	char **lines;
+	size_t max;
+	size_t count;
+	int timeout;
+} log_bridge_drain_call_t;
+
+
+/*
+ * Wait up to +timeout+ milliseconds for lines to be available in the ring, then
+ * move up to +max+ of them into the call's buffer; called without the GVL.
+ */
+static void *
+rzyre_log_bridge_drain_without_gvl( void *drain_call )
+{
+	log_bridge_drain_call_t *call = (log_bridge_drain_call_t *)drain_call;
+	struct rzyre_log_bridge *bridge = &rzyre_log_bridge;
+	struct timespec deadline;
+	int64_t deadline_ms = zclock_time() + call->timeout;
+
+	deadline.tv_sec = deadline_ms / 1000;
+	deadline.tv_nsec = ( deadline_ms % 1000 ) * 1000000;
+
+	pthread_mutex_lock( &bridge->mutex );
+
+	while ( !bridge->count && bridge->running && !bridge->interrupted ) {
+		if ( call->timeout < 0 ) {
+			pthread_cond_wait( &bridge->cond, &bridge->mutex );
+		} else if ( pthread_cond_timedwait(&bridge->cond, &bridge->mutex, &deadline) ) {
+			break;
+		}
+	}
+
+	while ( bridge->count && call->count < call->max ) {
+		call->lines[ call->count++ ] = bridge->lines[ bridge->head ];
+		bridge->head = ( bridge->head + 1 ) % bridge->capacity;
+		bridge->count--;
+	}
+
+	bridge->interrupted = FALSE;
+	pthread_mutex_unlock( &bridge->mutex );
+
+	return NULL;
+}
+
+
+/*
+ * Unblocking function for drains.
+ */
+static void
+rzyre_log_bridge_drain_ubf( void *unused )
+{
+	struct rzyre_log_bridge *bridge = &rzyre_log_bridge;
+
+	pthread_mutex_lock( &bridge->mutex );
+	bridge->interrupted = TRUE;
+	pthread_cond_broadcast( &bridge->cond );
+	pthread_mutex_unlock( &bridge->mutex );
+}
+
+
+/*
+ * call-seq:
+ *    Zyre::LogBridge.start_native( capacity )
+ *
+ * Route czmq's log output to the bridge, buffering up to +capacity+ lines until
+ * they're drained. Lines that arrive while the buffer is full are dropped and
+ * counted. Stderr logging is turned off while the bridge is running.
+ *
+ */
+static VALUE
+rzyre_log_bridge_s_start_native( VALUE module, VALUE capacity_arg )
+{
+	struct rzyre_log_bridge *bridge = &rzyre_log_bridge;
+	const long capacity = NUM2LONG( capacity_arg );
+	char **lines;
+
+	if ( !RZYRE_MAIN_RACTOR_P() )
+		rb_raise( rb_eRuntimeError, "the log bridge can only be started from the main Ractor" );
+	if ( capacity < 1 )
+		rb_raise( rb_eArgError, "capacity must be greater than 0" );
+	if ( bridge->actor )
+		rb_raise( rb_eRuntimeError, "the log bridge is already running" );
+
+	lines = (char **) zmalloc( capacity * sizeof *lines );
+
+	pthread_mutex_lock( &bridge->mutex );
+	rzyre_log_bridge_clear( bridge );
+	bridge->lines = lines;
+	bridge->capacity = capacity;
+	bridge->drops = 0;
+	bridge->running = TRUE;
+	pthread_mutex_unlock( &bridge->mutex );
+
+	zsys_set_logsender( RZYRE_LOG_BRIDGE_ENDPOINT );
+	bridge->actor = zactor_new( rzyre_log_bridge_actor, NULL );
+	zsys_set_logstream( NULL );
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    Zyre::LogBridge.stop_native
+ *
+ * Stop routing czmq's log output to the bridge, and resume logging to stderr.
+ * Lines already in the buffer can still be drained.
+ *
+ */
+static VALUE
+rzyre_log_bridge_s_stop_native( VALUE module )
+{
+	struct rzyre_log_bridge *bridge = &rzyre_log_bridge;
+
+	if ( !bridge->actor ) return Qfalse;
+
+	zsys_set_logstream( stderr );
+	zsys_set_logsender( NULL );
+	zactor_destroy( &bridge->actor );
+
+	pthread_mutex_lock( &bridge->mutex );
+	bridge->running = FALSE;
+	pthread_cond_broadcast( &bridge->cond );
+	pthread_mutex_unlock( &bridge->mutex );
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    Zyre::LogBridge.drain( max, timeout )   -> array or nil
+ *
+ * Wait up to +timeout+ floating-point seconds (or indefinitely if +timeout+ is -1)
+ * for log lines to arrive, then return up to +max+ of them. Returns +nil+ once the
+ * bridge has been stopped and the buffer is empty.
+ *
+ */
+static VALUE
+rzyre_log_bridge_s_drain( VALUE module, VALUE max_arg, VALUE timeout_arg )
+{
+	struct rzyre_log_bridge *bridge = &rzyre_log_bridge;
+	const long max = NUM2LONG( max_arg );
+	log_bridge_drain_call_t call;
+	VALUE tmpbuf;
+	VALUE rval;
+	size_t i;
+
+	if ( max < 1 )
+		rb_raise( rb_eArgError, "max must be greater than 0" );
+
+	call.lines = ALLOCV_N( char *, tmpbuf, max );
+	call.max = max;
+	call.count = 0;
+	call.timeout = NUM2DBL( timeout_arg ) < 0 ? -1 : floor( NUM2DBL(timeout_arg) * 1000 );
+
+	rb_thread_call_without_gvl2( rzyre_log_bridge_drain_without_gvl, (void *)&call,
+		rzyre_log_bridge_drain_ubf, NULL );
+
+	if ( !call.count && !bridge->running && !bridge->count ) {
+		rval = Qnil;
+	} else {
+		rval = rb_ary_new_capa( call.count );
+		for ( i = 0 ; i < call.count ; i++ ) {
+			rb_ary_push( rval, rb_str_new_cstr(call.lines[i]) );
+			zstr_free( &call.lines[i] );
+		}
+	}
+
+	ALLOCV_END( tmpbuf );
+
+	return rval;
+}
+
+
+/*
+ * call-seq:
+ *    Zyre::LogBridge.running?   -> true or false
+ *
+ * Returns +true+ if czmq's log output is currently being routed to the bridge.
+ *
+ */
+static VALUE
+rzyre_log_bridge_s_running_p( VALUE module )
+{
+	return rzyre_log_bridge.actor ? Qtrue : Qfalse;
+}
+
+
+/*
+ * call-seq:
+ *    Zyre::LogBridge.drops   -> integer
+ *
+ * Returns the number of log lines that have been dropped because the buffer was
+ * full since the bridge was last started.
+ *
+ */
+static VALUE
+rzyre_log_bridge_s_drops( VALUE module )
+{
+	struct rzyre_log_bridge *bridge = &rzyre_log_bridge;
+	unsigned long drops;
+
+	pthread_mutex_lock( &bridge->mutex );
+	drops = bridge->drops;
+	pthread_mutex_unlock( &bridge->mutex );
+
+	return ULONG2NUM( drops );
+}
+
+
+/*
+ * Initialize the LogBridge module.
+ */
+void
+rzyre_init_log_bridge( void ) {
+
+#ifdef FOR_RDOC
+	rzyre_mZyre = rb_define_module( "Zyre" );
+#endif
+
+	/*
+	 * Document-module: Zyre::LogBridge
+	 *
+	 * A bridge that forwards the log output of czmq and zyre to the :zyre logger.
+	 * zsys logging is published on an inproc socket and buffered by a background
+	 * actor, so a slow logger never holds up the threads that are logging.
+	 *
+	 * Refs:
+	 * - http://api.zeromq.org/czmq4-0:zsys#toc3
+	 *
+	 */
+	rzyre_mZyreLogBridge = rb_define_module_under( rzyre_mZyre, "LogBridge" );
+
+	rb_define_singleton_method( rzyre_mZyreLogBridge, "start_native",
+		rzyre_log_bridge_s_start_native, 1 );
+	rb_define_singleton_method( rzyre_mZyreLogBridge, "stop_native",
+		rzyre_log_bridge_s_stop_native, 0 );
+	rb_define_singleton_method( rzyre_mZyreLogBridge, "drain", rzyre_log_bridge_s_drain, 2 );
+	rb_define_singleton_method( rzyre_mZyreLogBridge, "running?", rzyre_log_bridge_s_running_p, 0 );
+	rb_define_singleton_method( rzyre_mZyreLogBridge, "drops", rzyre_log_bridge_s_drops, 0 );
+
+	rb_require( "zyre/log_bridge" );
+}
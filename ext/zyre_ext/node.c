@@ -12,12 +12,22 @@
 
 VALUE rzyre_cZyreNode;
 
+// Keys of the Hashes returned by #peer_info
+static VALUE sym_uuid, sym_name, sym_address, sym_headers;
+
+// Keyword arguments
+static ID id_timeout, id_capacity;
+
+// The keys of the Hash passed to #filter=
+static ID filter_keyword_ids[4];
+
+static void rzyre_node_mark( void *ptr );
 static void rzyre_node_free( void *ptr );
 
 static const rb_data_type_t rzyre_node_t = {
 	"Zyre::Node",
 	{
-		NULL,
+		rzyre_node_mark,
 		rzyre_node_free
 	},
 	0,
@@ -26,6 +36,26 @@ static const rb_data_type_t rzyre_node_t = {
 };
 
 
+/*
+ * Mark function
+ */
+static void
+rzyre_node_mark( void *ptr )
+{
+	rzyre_node_data_t *data = (rzyre_node_data_t *)ptr;
+
+	rb_gc_mark( data->io );
+	rb_gc_mark( data->filter_config );
+
+	if ( data->directory ) {
+		rb_gc_mark( data->directory->peers );
+		rb_gc_mark( data->directory->groups );
+		rb_gc_mark( data->directory->own_groups );
+		rb_gc_mark( data->directory->peer_info );
+	}
+}
+
+
 /*
  * Free function
  */
@@ -33,7 +63,15 @@ static void
 rzyre_node_free( void *ptr )
 {
 	if ( ptr ) {
-		zyre_destroy( (zyre_t **)&ptr );
+		rzyre_node_data_t *data = (rzyre_node_data_t *)ptr;
+
+		if ( data->reader ) rzyre_reader_destroy( &data->reader );
+		if ( data->node ) zyre_destroy( &data->node );
+		if ( data->directory ) xfree( data->directory );
+		rzyre_filter_destroy( &data->filter );
+		pthread_mutex_destroy( &data->filter_mutex );
+		pthread_mutex_destroy( &data->actor_mutex );
+		xfree( data );
 	}
 }
 
@@ -44,15 +82,24 @@ rzyre_node_free( void *ptr )
 static VALUE
 rzyre_node_alloc( VALUE klass )
 {
-	return TypedData_Wrap_Struct( klass, &rzyre_node_t, NULL );
+	rzyre_node_data_t *data;
+
+	VALUE rval = TypedData_Make_Struct( klass, rzyre_node_data_t, &rzyre_node_t, data );
+
+	data->io = Qnil;
+	data->filter_config = Qnil;
+	pthread_mutex_init( &data->filter_mutex, NULL );
+	pthread_mutex_init( &data->actor_mutex, NULL );
+
+	return rval;
 }
 
 
 /*
- * Fetch the data pointer and check it for sanity.
+ * Fetch the node data struct and check it for sanity.
  */
-inline zyre_t *
-rzyre_get_node( VALUE self )
+inline rzyre_node_data_t *
+rzyre_get_node_data( VALUE self )
 {
 	if ( !IsZyreNode(self) ) {
 		rb_raise( rb_eTypeError, "wrong argument type %s (expected Zyre::Node)",
@@ -63,6 +110,38 @@ rzyre_get_node( VALUE self )
 }
 
 
+/*
+ * Fetch the data pointer and check it for sanity.
+ */
+inline zyre_t *
+rzyre_get_node( VALUE self )
+{
+	return rzyre_get_node_data( self )->node;
+}
+
+
+/*
+ * Lock the pipe to the actor of the given +node+ for a call made with the GVL
+ * held. Calls made without the GVL lock it in rzyre_node_call_actor() instead.
+ * Nothing that can raise may happen before it's unlocked again.
+ */
+static void
+rzyre_node_lock_actor( VALUE node )
+{
+	pthread_mutex_lock( &rzyre_get_node_data(node)->actor_mutex );
+}
+
+
+/*
+ * Unlock the pipe to the actor of the given +node+.
+ */
+static void
+rzyre_node_unlock_actor( VALUE node )
+{
+	pthread_mutex_unlock( &rzyre_get_node_data(node)->actor_mutex );
+}
+
+
 /*
  * call-seq:
  *    Zyre::Node.new           -> node
@@ -75,7 +154,7 @@ rzyre_get_node( VALUE self )
 static VALUE
 rzyre_node_initialize( int argc, VALUE *argv, VALUE self )
 {
-	zyre_t *ptr;
+	rzyre_node_data_t *ptr;
 	VALUE name;
 	char *name_str = NULL;
 
@@ -85,10 +164,10 @@ rzyre_node_initialize( int argc, VALUE *argv, VALUE self )
 		name_str = StringValueCStr( name );
 	}
 
-	TypedData_Get_Struct( self, zyre_t, &rzyre_node_t, ptr );
-	if ( !ptr ) {
-		RTYPEDDATA_DATA( self ) = ptr = zyre_new( name_str );
-		assert( ptr );
+	TypedData_Get_Struct( self, rzyre_node_data_t, &rzyre_node_t, ptr );
+	if ( !ptr->node ) {
+		ptr->node = zyre_new( name_str );
+		assert( ptr->node );
 	}
 
 	return self;
@@ -106,8 +185,16 @@ static VALUE
 rzyre_node_uuid( VALUE self )
 {
 	zyre_t *ptr = rzyre_get_node( self );
-	const char *uuid_str = zyre_uuid( ptr );
-	VALUE uuid = rb_str_new2( uuid_str );
+	char *uuid_str;
+	VALUE uuid;
+
+	// The actor's string is only good until the next call to it
+	rzyre_node_lock_actor( self );
+	uuid_str = strdup( zyre_uuid(ptr) );
+	rzyre_node_unlock_actor( self );
+
+	uuid = rb_str_new2( uuid_str );
+	free( uuid_str );
 
 	return rb_str_freeze( uuid );
 }
@@ -124,8 +211,15 @@ static VALUE
 rzyre_node_name( VALUE self )
 {
 	zyre_t *ptr = rzyre_get_node( self );
-	const char *name_str = zyre_name( ptr );
-	VALUE name = rb_str_new2( name_str );
+	char *name_str;
+	VALUE name;
+
+	rzyre_node_lock_actor( self );
+	name_str = strdup( zyre_name(ptr) );
+	rzyre_node_unlock_actor( self );
+
+	name = rb_str_new2( name_str );
+	free( name_str );
 
 	return rb_str_freeze( name );
 }
@@ -145,7 +239,9 @@ rzyre_node_name_eq( VALUE self, VALUE new_name )
 	zyre_t *ptr = rzyre_get_node( self );
 	const char *name_str = StringValueCStr( new_name );
 
+	rzyre_node_lock_actor( self );
 	zyre_set_name( ptr, name_str );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
@@ -166,7 +262,9 @@ rzyre_node_port_eq( VALUE self, VALUE new_port )
 	zyre_t *ptr = rzyre_get_node( self );
 	int port_nbr = FIX2INT( new_port );
 
+	rzyre_node_lock_actor( self );
 	zyre_set_port( ptr, port_nbr );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
@@ -188,7 +286,9 @@ rzyre_node_evasive_timeout_eq( VALUE self, VALUE timeout )
 	zyre_t *ptr = rzyre_get_node( self );
 	int timeout_ms = FIX2INT( timeout );
 
+	rzyre_node_lock_actor( self );
 	zyre_set_evasive_timeout( ptr, timeout_ms );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
@@ -216,7 +316,9 @@ rzyre_node_silent_timeout_eq( VALUE self, VALUE timeout )
 	zyre_t *ptr = rzyre_get_node( self );
 	int timeout_ms = FIX2INT( timeout );
 
+	rzyre_node_lock_actor( self );
 	zyre_set_silent_timeout( ptr, timeout_ms );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
@@ -239,7 +341,9 @@ rzyre_node_expired_timeout_eq( VALUE self, VALUE timeout )
 	zyre_t *ptr = rzyre_get_node( self );
 	int timeout_ms = FIX2INT( timeout );
 
+	rzyre_node_lock_actor( self );
 	zyre_set_expired_timeout( ptr, timeout_ms );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
@@ -259,7 +363,9 @@ rzyre_node_interval_eq( VALUE self, VALUE interval )
 	zyre_t *ptr = rzyre_get_node( self );
 	size_t interval_ms = FIX2INT( interval );
 
+	rzyre_node_lock_actor( self );
 	zyre_set_interval( ptr, interval_ms );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
@@ -280,7 +386,9 @@ rzyre_node_interface_eq( VALUE self, VALUE interface )
 	zyre_t *ptr = rzyre_get_node( self );
 	const char *interface_str = StringValueCStr( interface );
 
+	rzyre_node_lock_actor( self );
 	zyre_set_interface( ptr, interface_str );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
@@ -307,7 +415,9 @@ rzyre_node_endpoint_eq( VALUE self, VALUE endpoint )
 	const char *endpoint_str = StringValueCStr( endpoint );
 	int res;
 
+	rzyre_node_lock_actor( self );
 	res = zyre_set_endpoint( ptr, "%s", endpoint_str );
+	rzyre_node_unlock_actor( self );
 
 	if ( res == 0 ) return Qtrue;
 	return Qfalse;
@@ -345,7 +455,9 @@ rzyre_node_verbose_bang( VALUE self )
 {
 	zyre_t *ptr = rzyre_get_node( self );
 
+	rzyre_node_lock_actor( self );
 	zyre_set_verbose( ptr );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
@@ -353,369 +465,1737 @@ rzyre_node_verbose_bang( VALUE self )
 
 /*
  * call-seq:
- *    node.set_header( name, value )
+ *    node.zero_copy = true or false
  *
- * Set node header; these are provided to other nodes during discovery
- * and come in each `ENTER` message.
+ * If set to +true+, frozen Strings of 64KB or more passed to #whisper and #shout
+ * are handed to CZMQ without being copied; the String is kept alive until ZeroMQ
+ * is done with the frame that refers to it. Unfrozen Strings and smaller ones,
+ * which are cheaper to copy, are always copied. Defaults to +false+.
  *
  */
 static VALUE
-rzyre_node_set_header( VALUE self, VALUE name, VALUE value )
+rzyre_node_zero_copy_eq( VALUE self, VALUE flag )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	const char *name_str = StringValueCStr( name );
-	const char *value_str = StringValueCStr( value );
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
 
-	rzyre_log_obj( self, "debug", "Setting header `%s` to `%s`", name_str, value_str );
-	zyre_set_header( ptr, name_str, "%s", value_str );
+	ptr->zero_copy = RTEST( flag );
 
-	return Qtrue;
+	return flag;
 }
 
 
 /*
  * call-seq:
- *    node.gossip_bind( endpoint )
+ *    node.zero_copy?   -> true or false
  *
- * Set-up gossip discovery of other nodes. At least one node in the cluster
- * must bind to a well-known gossip endpoint, so other nodes can connect to
- * it. Note that gossip endpoints are completely distinct from Zyre node
- * endpoints, and should not overlap (they can use the same transport).
+ * Returns +true+ if the node hands frozen Strings to CZMQ without copying them.
  *
  */
 static VALUE
-rzyre_node_gossip_bind( VALUE self, VALUE endpoint )
+rzyre_node_zero_copy_p( VALUE self )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	const char *endpoint_str = StringValueCStr( endpoint );
-
-	assert( endpoint_str );
-	rzyre_log_obj( self, "debug", "Binding to gossip endpoint %s.", endpoint_str );
-	zyre_gossip_bind( ptr, "%s", endpoint_str );
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
 
-	return Qtrue;
+	return ptr->zero_copy ? Qtrue : Qfalse;
 }
 
 
 /*
  * call-seq:
- *    node.gossip_connect( endpoint )
+ *    node.compression_threshold = bytes or nil
  *
- * Set-up gossip discovery of other nodes. A node may connect to multiple
- * other nodes, for redundancy paths. For details of the gossip network
- * design, see the CZMQ zgossip class.
+ * If set to an Integer, frames larger than that many +bytes+ are compressed with
+ * zlib before they're sent by #whisper, #shout, and the batch and encoded
+ * variants, as long as compressing them makes them smaller. Compressed frames
+ * which arrive at the node are decompressed before they're returned as events,
+ * so peers that send compressed frames should all have compression enabled.
+ * Setting it to +nil+ (the default) turns compression off.
  *
  */
 static VALUE
-rzyre_node_gossip_connect( VALUE self, VALUE endpoint )
+rzyre_node_compression_threshold_eq( VALUE self, VALUE threshold )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	const char *endpoint_str = StringValueCStr( endpoint );
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
 
-	assert( endpoint_str );
-	rzyre_log_obj( self, "debug", "Connecting to gossip endpoint %s.", endpoint_str );
-	zyre_gossip_connect( ptr, "%s", endpoint_str );
+	if ( NIL_P(threshold) ) {
+		ptr->compression = FALSE;
+		ptr->compression_threshold = 0;
+	} else {
+		if ( !rzyre_compression_available() )
+			rb_raise( rb_eNotImpError, "compression requires an extension built with zlib" );
 
-	return Qtrue;
+		ptr->compression_threshold = NUM2SIZET( threshold );
+		ptr->compression = TRUE;
+	}
+
+	return threshold;
 }
 
 
 /*
  * call-seq:
- *    node.start  -> bool
+ *    node.compression_threshold   -> integer or nil
  *
- * Start node, after setting header values. When you start a node it
- * begins discovery and connection. Returns +true+ if the node was started
- * successfully.
+ * Returns the size in bytes above which frames are compressed before they're
+ * sent, or +nil+ if compression is turned off.
  *
  */
 static VALUE
-rzyre_node_start( VALUE self )
+rzyre_node_compression_threshold( VALUE self )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	int res;
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
 
-	rzyre_log_obj( self, "debug", "Starting." );
-	res = zyre_start( ptr );
+	if ( !ptr->compression ) return Qnil;
 
-	if ( res == 0 ) return Qtrue;
-	return Qfalse;
+	return SIZET2NUM( ptr->compression_threshold );
 }
 
 
 /*
- * call-seq:
- *    node.stop
- *
- * Stop node; this signals to other peers that this node will go away.
- * This is polite; however you can also just destroy the node without
- * stopping it.
- *
+ * Return a Hash describing the given compression +stats+.
  */
 static VALUE
-rzyre_node_stop( VALUE self )
+rzyre_compression_stats_hash( const rzyre_compression_stats_t *stats )
 {
-	zyre_t *ptr = rzyre_get_node( self );
+	VALUE rval = rb_hash_new();
+	const double ratio = stats->compressed_bytes ?
+		(double)stats->raw_bytes / stats->compressed_bytes : 0.0;
 
-	assert( ptr );
-	rzyre_log_obj( self, "debug", "Stopping." );
-	zyre_stop( ptr );
+	rb_hash_aset( rval, ID2SYM(rb_intern("frames")), ULONG2NUM(stats->frames) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("raw_bytes")), ULL2NUM(stats->raw_bytes) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("compressed_bytes")), ULL2NUM(stats->compressed_bytes) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("ratio")), DBL2NUM(ratio) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("cpu_time")), DBL2NUM(stats->cpu_ns / 1e9) );
 
-	return Qtrue;
+	return rval;
 }
 
 
 /*
  * call-seq:
- *    node.join( group_name )    -> int
+ *    node.compression_stats   -> hash
  *
- * Join a named group; after joining a group you can send messages to
- * the group and all Zyre nodes in that group will receive them.
+ * Returns a Hash of counters for the frames the node has compressed and
+ * decompressed: the number of +frames+, their size before (+raw_bytes+) and
+ * after (+compressed_bytes+) compression, the compression +ratio+, and the
+ * +cpu_time+ in seconds spent on it.
+ *
+ *    node.compression_stats
+ *    # => {compressed: {frames: 12, raw_bytes: 1228800, compressed_bytes: 40411,
+ *    #       ratio: 30.4, cpu_time: 0.0071}, decompressed: {...}}
  *
  */
 static VALUE
-rzyre_node_join( VALUE self, VALUE group )
+rzyre_node_compression_stats( VALUE self )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	const char *group_str = StringValueCStr( group );
-	int res;
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
+	rzyre_compression_stats_t decompressed = ptr->decompressed;
+	VALUE rval = rb_hash_new();
+
+	if ( ptr->reader ) rzyre_reader_add_stats( ptr->reader, &decompressed );
 
-	rzyre_log_obj( self, "debug", "Joining group %s.", group_str );
-	res = zyre_join( ptr, group_str );
+	rb_hash_aset( rval, ID2SYM(rb_intern("compressed")), rzyre_compression_stats_hash(&ptr->compressed) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("decompressed")), rzyre_compression_stats_hash(&decompressed) );
 
-	return INT2FIX( res );
+	return rval;
 }
 
 
 /*
  * call-seq:
- *    node.leave( group_name )    -> int
+ *    node.set_header( name, value )
  *
- * Leave a group.
+ * Set node header; these are provided to other nodes during discovery
+ * and come in each `ENTER` message.
  *
  */
 static VALUE
-rzyre_node_leave( VALUE self, VALUE group )
+rzyre_node_set_header( VALUE self, VALUE name, VALUE value )
 {
 	zyre_t *ptr = rzyre_get_node( self );
-	const char *group_str = StringValueCStr( group );
-	int res;
+	const char *name_str = StringValueCStr( name );
+	const char *value_str = StringValueCStr( value );
 
-	rzyre_log_obj( self, "debug", "Leaving group %s.", group_str );
-	res = zyre_leave( ptr, group_str );
+	rzyre_log_obj( self, "debug", "Setting header `%s` to `%s`", name_str, value_str );
+	rzyre_node_lock_actor( self );
+	zyre_set_header( ptr, name_str, "%s", value_str );
+	rzyre_node_unlock_actor( self );
 
-	return INT2FIX( res );
+	return Qtrue;
 }
 
 
 /*
  * call-seq:
- *    node.recv -> zyre_event
+ *    node.gossip_bind( endpoint )
  *
- * Receive the next event from the network; the message may be a control
- * message (ENTER, EXIT, JOIN, LEAVE) or data (WHISPER, SHOUT).
- * Returns a Zyre::Event.
+ * Set-up gossip discovery of other nodes. At least one node in the cluster
+ * must bind to a well-known gossip endpoint, so other nodes can connect to
+ * it. Note that gossip endpoints are completely distinct from Zyre node
+ * endpoints, and should not overlap (they can use the same transport).
  *
  */
 static VALUE
-rzyre_node_recv( VALUE self )
+rzyre_node_gossip_bind( VALUE self, VALUE endpoint )
 {
-	return rb_funcall( rzyre_cZyreEvent, rb_intern("from_node"), 1, self );
+	zyre_t *ptr = rzyre_get_node( self );
+	const char *endpoint_str = StringValueCStr( endpoint );
+
+	assert( endpoint_str );
+	rzyre_log_obj( self, "debug", "Binding to gossip endpoint %s.", endpoint_str );
+	rzyre_node_lock_actor( self );
+	zyre_gossip_bind( ptr, "%s", endpoint_str );
+	rzyre_node_unlock_actor( self );
+
+	return Qtrue;
 }
 
 
 /*
  * call-seq:
- *    node.whisper( peer_uuid, *messages )  -> int
+ *    node.gossip_connect( endpoint )
  *
- * Send a +message+ to a single +peer+ specified as a UUID string.
+ * Set-up gossip discovery of other nodes. A node may connect to multiple
+ * other nodes, for redundancy paths. For details of the gossip network
+ * design, see the CZMQ zgossip class.
  *
  */
 static VALUE
-rzyre_node_whisper( int argc, VALUE *argv, VALUE self )
+rzyre_node_gossip_connect( VALUE self, VALUE endpoint )
 {
 	zyre_t *ptr = rzyre_get_node( self );
-	VALUE peer_uuid, msg_parts;
-	char *peer_uuid_str;
-	zmsg_t *msg;
-	int rval;
-
-	rb_scan_args( argc, argv, "1*", &peer_uuid, &msg_parts );
-
-	peer_uuid_str = StringValueCStr( peer_uuid );
-	msg = rzyre_make_zmsg_from( msg_parts );
+	const char *endpoint_str = StringValueCStr( endpoint );
 
-	rval = zyre_whisper( ptr, peer_uuid_str, &msg );
+	assert( endpoint_str );
+	rzyre_log_obj( self, "debug", "Connecting to gossip endpoint %s.", endpoint_str );
+	rzyre_node_lock_actor( self );
+	zyre_gossip_connect( ptr, "%s", endpoint_str );
+	rzyre_node_unlock_actor( self );
 
-	return rval ? Qtrue : Qfalse;
+	return Qtrue;
 }
 
 
 /*
- * call-seq:
- *    node.shout( group, *messages )   -> int
- *
- * Send +message+ to a named +group+.
- *
+ * Arguments for, and results of, a call to the zyre actor made without the GVL.
  */
-static VALUE
-rzyre_node_shout( int argc, VALUE *argv, VALUE self )
-{
-	zyre_t *ptr = rzyre_get_node( self );
-	VALUE group, msg_parts;
-	char *group_str;
+typedef struct {
+	zyre_t *node;
+	const char *arg1;
+	const char *arg2;
 	zmsg_t *msg;
-	int rval;
+	int result;
+	void *rval;
+	int compress;
+	size_t compress_above;
+	rzyre_compression_stats_t stats;
+	void *(*func)( void * );
+	pthread_mutex_t *actor_mutex;
+} actor_call_t;
 
-	rb_scan_args( argc, argv, "1*", &group, &msg_parts );
 
-	group_str = StringValueCStr( group );
-	msg = rzyre_make_zmsg_from( msg_parts );
+/*
+ * Compress the call's message if it should be, then make the call with the node's
+ * actor pipe locked; called without the GVL.
+ */
+static void *
+rzyre_node_call_actor_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+
+	if ( call->compress ) rzyre_compress_msg( call->msg, call->compress_above, &call->stats );
 
-	rval = zyre_shout( ptr, group_str, &msg );
+	pthread_mutex_lock( call->actor_mutex );
+	call->func( call );
+	pthread_mutex_unlock( call->actor_mutex );
 
-	return rval ? Qtrue : Qfalse;
+	return NULL;
 }
 
 
 /*
- * call-seq:
- *    node.peers -> array
- *
- * Return an Array of current peer UUIDs.
- *
+ * Call +func+ with the +call+ to the actor of the given +node+ with the GVL
+ * released. Other threads can be using the same node, so the actor pipe is locked
+ * for the whole exchange; otherwise their requests and replies could interleave.
+ * The calls are request/reply exchanges over the actor pipe which would leave it
+ * out of sync if they were abandoned partway through, so there is no unblocking
+ * function; pending interrupts are handled as soon as the call returns.
  */
-static VALUE
-rzyre_node_peers( VALUE self )
+static void
+rzyre_node_call_actor( VALUE node, void *(*func)(void *), actor_call_t *call )
 {
-	zyre_t *ptr;
-	zlist_t *peers;
-	VALUE rary = rb_ary_new();
-	char *item = NULL;
+	call->func = func;
+	call->actor_mutex = &rzyre_get_node_data( node )->actor_mutex;
 
-	ptr = rzyre_get_node( self );
-	assert( ptr );
-
-	peers = zyre_peers( ptr );
-	assert( peers );
+	rb_thread_call_without_gvl( rzyre_node_call_actor_without_gvl, (void *)call, NULL, NULL );
+}
 
-	item = zlist_first( peers );
-	while ( item ) {
-		rb_ary_push( rary, rb_str_new2(item) );
-		item = zlist_next( peers );
-	}
 
-	zlist_destroy( &peers );
-	return rary;
+static void *
+rzyre_node_start_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->result = zyre_start( call->node );
+	return NULL;
 }
 
+static void *
+rzyre_node_stop_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	zyre_stop( call->node );
+	return NULL;
+}
 
-/*
- * call-seq:
- *    node.peers_by_group( group ) -> array
- *
- * Return an Array of the current peers in the specified +group+.
- *
- */
-static VALUE
-rzyre_node_peers_by_group( VALUE self, VALUE group )
+static void *
+rzyre_node_join_without_gvl( void *call_ptr )
 {
-	zyre_t *ptr;
-	const char *group_str = StringValueCStr( group );
-	zlist_t *peers;
-	VALUE rary = rb_ary_new();
-	char *item = NULL;
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->result = zyre_join( call->node, call->arg1 );
+	return NULL;
+}
 
-	ptr = rzyre_get_node( self );
-	assert( ptr );
+static void *
+rzyre_node_leave_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->result = zyre_leave( call->node, call->arg1 );
+	return NULL;
+}
 
-	peers = zyre_peers_by_group( ptr, group_str );
-	assert( peers );
+static void *
+rzyre_node_whisper_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->result = zyre_whisper( call->node, call->arg1, &call->msg );
+	return NULL;
+}
 
-	item = zlist_first( peers );
-	while ( item ) {
-		rb_ary_push( rary, rb_str_new2(item) );
-		item = zlist_next( peers );
-	}
+static void *
+rzyre_node_shout_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->result = zyre_shout( call->node, call->arg1, &call->msg );
+	return NULL;
+}
 
-	zlist_destroy( &peers );
-	return rary;
+static void *
+rzyre_node_peers_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->rval = zyre_peers( call->node );
+	return NULL;
 }
 
+static void *
+rzyre_node_peers_by_group_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->rval = zyre_peers_by_group( call->node, call->arg1 );
+	return NULL;
+}
 
-/*
- * call-seq:
- *    node.own_groups -> array
- *
- * Return an Array of the names of the receiving node's current groups.
- *
- */
-static VALUE
-rzyre_node_own_groups( VALUE self )
+static void *
+rzyre_node_own_groups_without_gvl( void *call_ptr )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	zlist_t *groups = zyre_own_groups( ptr );
-	VALUE rary = rb_ary_new();
-	char *item = NULL;
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->rval = zyre_own_groups( call->node );
+	return NULL;
+}
 
-	assert( groups );
+static void *
+rzyre_node_peer_groups_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->rval = zyre_peer_groups( call->node );
+	return NULL;
+}
 
-	item = zlist_first( groups );
-	while ( item ) {
-		rb_ary_push( rary, rb_str_new2(item) );
-		item = zlist_next( groups );
-	}
+static void *
+rzyre_node_peer_address_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->rval = zyre_peer_address( call->node, call->arg1 );
+	return NULL;
+}
 
-	zlist_destroy( &groups );
-	return rary;
+static void *
+rzyre_node_peer_header_value_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	call->rval = zyre_peer_header_value( call->node, call->arg1, call->arg2 );
+	return NULL;
 }
 
 
 /*
- * call-seq:
- *    node.peer_groups  -> array
- *
- * Return an Array of the names of groups known through connected peers.
- *
+ * Convert a list of strings returned from the actor into an Array, destroying the
+ * list.
  */
 static VALUE
-rzyre_node_peer_groups( VALUE self )
+rzyre_ary_from_zlist( zlist_t **list )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	zlist_t *groups = zyre_peer_groups( ptr );
 	VALUE rary = rb_ary_new();
 	char *item = NULL;
 
-	assert( groups );
+	assert( *list );
 
-	item = zlist_first( groups );
+	item = zlist_first( *list );
 	while ( item ) {
 		rb_ary_push( rary, rb_str_new2(item) );
-		item = zlist_next( groups );
+		item = zlist_next( *list );
 	}
 
-	zlist_destroy( &groups );
+	zlist_destroy( list );
 	return rary;
 }
 
 
+/* --------------------------------------------------------------
+ * Local directory
+ * -------------------------------------------------------------- */
+
 /*
- * call-seq:
- *    node.peer_address( peer_uuid ) -> str
- *
- * Return the endpoint of a connected +peer+.
- * Returns nil if peer does not exist.
- *
+ * Push the given +key+ onto the Array +keys+.
  */
-static VALUE
-rzyre_node_peer_address( VALUE self, VALUE peer_uuid )
+static int
+rzyre_push_hash_key( VALUE key, VALUE value, VALUE keys )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	const char *peer = StringValueCStr( peer_uuid );
-	char *address = zyre_peer_address( ptr, peer );
-	VALUE rval = Qnil;
+	rb_ary_push( keys, key );
+	return ST_CONTINUE;
+}
 
-	if ( strnlen(address, BUFSIZ) ) {
+
+/*
+ * Return the keys of the given +hash+ as an Array.
+ */
+static VALUE
+rzyre_hash_keys( VALUE hash )
+{
+	VALUE keys = rb_ary_new_capa( RHASH_SIZE(hash) );
+
+	rb_hash_foreach( hash, rzyre_push_hash_key, keys );
+
+	return keys;
+}
+
+
+/*
+ * Add the peer with the given +uuid+ to the directory if it isn't already in it,
+ * and return the Hash of its groups.
+ */
+static VALUE
+rzyre_directory_add_peer( rzyre_node_directory_t *dir, VALUE uuid )
+{
+	VALUE peer_groups = rb_hash_lookup2( dir->peers, uuid, Qnil );
+
+	if ( NIL_P(peer_groups) ) {
+		peer_groups = rb_hash_new();
+		rb_hash_aset( dir->peers, uuid, peer_groups );
+		dir->generation++;
+	}
+
+	return peer_groups;
+}
+
+
+/*
+ * Record that the peer with the given +uuid+ is a member of +group+.
+ */
+static void
+rzyre_directory_add_member( rzyre_node_directory_t *dir, VALUE uuid, VALUE group )
+{
+	VALUE peer_groups = rzyre_directory_add_peer( dir, uuid );
+	VALUE members;
+
+	if ( rb_hash_lookup2(peer_groups, group, Qundef) != Qundef ) return;
+
+	members = rb_hash_lookup2( dir->groups, group, Qnil );
+	if ( NIL_P(members) ) {
+		members = rb_hash_new();
+		rb_hash_aset( dir->groups, group, members );
+	}
+
+	rb_hash_aset( peer_groups, group, Qtrue );
+	rb_hash_aset( members, uuid, Qtrue );
+	dir->generation++;
+}
+
+
+/*
+ * Remove the peer with the given +uuid+ from the members of +group+ (but not from
+ * the peer's own Hash of groups), dropping the group if it's left empty.
+ */
+static void
+rzyre_directory_drop_member( rzyre_node_directory_t *dir, VALUE uuid, VALUE group )
+{
+	VALUE members = rb_hash_lookup2( dir->groups, group, Qnil );
+
+	if ( NIL_P(members) ) return;
+
+	rb_hash_delete( members, uuid );
+	if ( RHASH_EMPTY_P(members) ) rb_hash_delete( dir->groups, group );
+}
+
+
+/*
+ * Record that the peer with the given +uuid+ has left +group+.
+ */
+static void
+rzyre_directory_remove_member( rzyre_node_directory_t *dir, VALUE uuid, VALUE group )
+{
+	VALUE peer_groups = rb_hash_lookup2( dir->peers, uuid, Qnil );
+
+	if ( NIL_P(peer_groups) || NIL_P(rb_hash_delete(peer_groups, group)) ) return;
+
+	rzyre_directory_drop_member( dir, uuid, group );
+	dir->generation++;
+}
+
+
+// Struct for passing arguments to rzyre_directory_drop_peer_group()
+typedef struct {
+	rzyre_node_directory_t *dir;
+	VALUE uuid;
+} drop_peer_call_t;
+
+
+/*
+ * Remove a departing peer from one of its groups.
+ */
+static int
+rzyre_directory_drop_peer_group( VALUE group, VALUE unused, VALUE drop_call )
+{
+	drop_peer_call_t *call = (drop_peer_call_t *)drop_call;
+
+	rzyre_directory_drop_member( call->dir, call->uuid, group );
+
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Remove the peer with the given +uuid+ and its group memberships from the
+ * directory.
+ */
+static void
+rzyre_directory_remove_peer( rzyre_node_directory_t *dir, VALUE uuid )
+{
+	VALUE peer_groups = rb_hash_delete( dir->peers, uuid );
+	drop_peer_call_t call = { dir, uuid };
+
+	if ( NIL_P(peer_groups) ) return;
+
+	rb_hash_foreach( peer_groups, rzyre_directory_drop_peer_group, (VALUE)&call );
+	dir->generation++;
+}
+
+
+/*
+ * Record the name, address, and headers the peer that sent the given ENTER +event+
+ * announced.
+ */
+static void
+rzyre_directory_add_peer_info( rzyre_node_directory_t *dir, VALUE uuid, zyre_event_t *event )
+{
+	VALUE info = rb_hash_new();
+	const char *address = zyre_event_peer_addr( event );
+
+	rb_hash_aset( info, sym_uuid, uuid );
+	rb_hash_aset( info, sym_name, rzyre_interned_str(zyre_event_peer_name(event)) );
+	rb_hash_aset( info, sym_address, address ? rzyre_interned_str(address) : Qnil );
+	rb_hash_aset( info, sym_headers, rzyre_frozen_hash_from_zhash(zyre_event_headers(event)) );
+
+	rb_hash_aset( dir->peer_info, uuid, rb_obj_freeze(info) );
+}
+
+
+/*
+ * Update the local directory of the given +node+ (if it has one) from the given
+ * +event+. This is called for every event the node receives, before it's wrapped.
+ */
+void
+rzyre_node_observe_event( VALUE node, zyre_event_t *event )
+{
+	rzyre_node_directory_t *dir = rzyre_get_node_data( node )->directory;
+	const char *type;
+
+	if ( !dir ) return;
+
+	type = zyre_event_type( event );
+
+	if ( streq(type, "ENTER") ) {
+		const VALUE uuid = rzyre_interned_str( zyre_event_peer_uuid(event) );
+
+		rzyre_directory_add_peer( dir, uuid );
+		rzyre_directory_add_peer_info( dir, uuid, event );
+	}
+	else if ( streq(type, "EXIT") ) {
+		const VALUE uuid = rzyre_interned_str( zyre_event_peer_uuid(event) );
+
+		rzyre_directory_remove_peer( dir, uuid );
+		rb_hash_delete( dir->peer_info, uuid );
+	}
+	else if ( streq(type, "JOIN") ) {
+		rzyre_directory_add_member( dir, rzyre_interned_str(zyre_event_peer_uuid(event)),
+			rzyre_interned_str(zyre_event_group(event)) );
+	}
+	else if ( streq(type, "LEAVE") ) {
+		rzyre_directory_remove_member( dir, rzyre_interned_str(zyre_event_peer_uuid(event)),
+			rzyre_interned_str(zyre_event_group(event)) );
+	}
+	else if ( streq(type, "STOP") ) {
+		rb_hash_clear( dir->peers );
+		rb_hash_clear( dir->groups );
+		rb_hash_clear( dir->peer_info );
+		dir->generation++;
+	}
+}
+
+
+/*
+ * call-seq:
+ *    node.start  -> bool
+ *
+ * Start node, after setting header values. When you start a node it
+ * begins discovery and connection. Returns +true+ if the node was started
+ * successfully.
+ *
+ */
+static VALUE
+rzyre_node_start( VALUE self )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+
+	rzyre_log_obj( self, "debug", "Starting." );
+	rzyre_node_call_actor( self, rzyre_node_start_without_gvl, &call );
+
+	if ( call.result == 0 ) return Qtrue;
+	return Qfalse;
+}
+
+
+/*
+ * call-seq:
+ *    node.stop
+ *
+ * Stop node; this signals to other peers that this node will go away.
+ * This is polite; however you can also just destroy the node without
+ * stopping it.
+ *
+ */
+static VALUE
+rzyre_node_stop( VALUE self )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+
+	assert( call.node );
+	rzyre_log_obj( self, "debug", "Stopping." );
+	rzyre_node_call_actor( self, rzyre_node_stop_without_gvl, &call );
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    node.join( group_name )    -> int
+ *
+ * Join a named group; after joining a group you can send messages to
+ * the group and all Zyre nodes in that group will receive them.
+ *
+ */
+static VALUE
+rzyre_node_join( VALUE self, VALUE group )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+	rzyre_node_directory_t *dir;
+
+	call.arg1 = StringValueCStr( group );
+
+	rzyre_log_obj( self, "debug", "Joining group %s.", call.arg1 );
+	rb_str_locktmp( group );
+	rzyre_node_call_actor( self, rzyre_node_join_without_gvl, &call );
+	rb_str_unlocktmp( group );
+
+	if ( (dir = rzyre_get_node_data(self)->directory) ) {
+		rb_hash_aset( dir->own_groups, rzyre_interned_str(call.arg1), Qtrue );
+		dir->generation++;
+	}
+
+	return INT2FIX( call.result );
+}
+
+
+/*
+ * call-seq:
+ *    node.leave( group_name )    -> int
+ *
+ * Leave a group.
+ *
+ */
+static VALUE
+rzyre_node_leave( VALUE self, VALUE group )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+	rzyre_node_directory_t *dir;
+
+	call.arg1 = StringValueCStr( group );
+
+	rzyre_log_obj( self, "debug", "Leaving group %s.", call.arg1 );
+	rb_str_locktmp( group );
+	rzyre_node_call_actor( self, rzyre_node_leave_without_gvl, &call );
+	rb_str_unlocktmp( group );
+
+	if ( (dir = rzyre_get_node_data(self)->directory) ) {
+		if ( !NIL_P(rb_hash_delete(dir->own_groups, rzyre_interned_str(call.arg1))) )
+			dir->generation++;
+	}
+
+	return INT2FIX( call.result );
+}
+
+
+/*
+ * call-seq:
+ *    node.recv                 -> zyre_event
+ *    node.recv( timeout: 1.5 ) -> zyre_event or nil
+ *
+ * Receive the next event from the network; the message may be a control
+ * message (ENTER, EXIT, JOIN, LEAVE) or data (WHISPER, SHOUT).
+ * Returns a Zyre::Event. If a +timeout+ (in floating-point seconds) is given and
+ * no event arrives before it expires, returns +nil+. A +timeout+ of -1 or +nil+
+ * means wait indefinitely.
+ *
+ */
+static VALUE
+rzyre_node_recv( int argc, VALUE *argv, VALUE self )
+{
+	VALUE opts, timeout_arg = Qundef;
+	int timeout = -1;
+
+	rb_scan_args( argc, argv, "0:", &opts );
+	if ( !NIL_P(opts) ) rb_get_kwargs( opts, &id_timeout, 0, 1, &timeout_arg );
+
+	if ( timeout_arg != Qundef && !NIL_P(timeout_arg) && NUM2DBL(timeout_arg) >= 0 ) {
+		timeout = floor( NUM2DBL(timeout_arg) * 1000 );
+	}
+
+	return rzyre_read_event_from_node( self, timeout );
+}
+
+
+/*
+ * Return the background reader of the given +node+ if it has one that's running or
+ * still has events waiting, dropping the node's reference to it if it's been
+ * stopped and drained.
+ */
+rzyre_reader_t *
+rzyre_node_reader( VALUE node )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( node );
+
+	if ( ptr->reader && !rzyre_reader_active(ptr->reader) ) {
+		rzyre_reader_add_stats( ptr->reader, &ptr->decompressed );
+		rzyre_reader_destroy( &ptr->reader );
+	}
+
+	return ptr->reader;
+}
+
+
+/*
+ * Raise a RuntimeError if the given +node+ has a background reader running. Its
+ * actor reads the node's socket, and ZeroMQ sockets can't be used from more than
+ * one thread, so nothing else may poll or read it until the reader is stopped.
+ */
+void
+rzyre_node_check_reader( VALUE node )
+{
+	rzyre_reader_t *reader = rzyre_node_reader( node );
+	rzyre_reader_counters_t counters;
+
+	if ( !reader ) return;
+
+	rzyre_reader_counters( reader, &counters );
+	if ( counters.running )
+		rb_raise( rb_eRuntimeError, "%+"PRIsVALUE" has a background reader running", node );
+}
+
+
+/*
+ * Mark the nodes in the given Array as no longer being polled; the ensure function
+ * of rzyre_nodes_polling().
+ */
+static VALUE
+rzyre_nodes_polling_ensure( VALUE nodes )
+{
+	for ( long i = 0 ; i < RARRAY_LEN(nodes) ; i++ )
+		rzyre_get_node_data( RARRAY_AREF(nodes, i) )->polled--;
+
+	return Qnil;
+}
+
+
+/*
+ * Call +func+ with +arg+ while the nodes in the given Array are marked as being
+ * polled, which keeps a background reader from being started on any of them, and
+ * return what it returns. Raises a RuntimeError without calling +func+ if one of
+ * them already has a reader running. The Array mustn't change until +func+
+ * returns.
+ */
+VALUE
+rzyre_nodes_polling( VALUE nodes, VALUE (*func)(VALUE), VALUE arg )
+{
+	long i;
+
+	for ( i = 0 ; i < RARRAY_LEN(nodes) ; i++ )
+		rzyre_node_check_reader( RARRAY_AREF(nodes, i) );
+	for ( i = 0 ; i < RARRAY_LEN(nodes) ; i++ )
+		rzyre_get_node_data( RARRAY_AREF(nodes, i) )->polled++;
+
+	return rb_ensure( func, arg, rzyre_nodes_polling_ensure, nodes );
+}
+
+
+/*
+ * call-seq:
+ *    node.start_reader( capacity: 1024 )   -> true
+ *
+ * Start a background thread that reads the node's events as soon as they arrive,
+ * without needing the GVL, and buffers up to +capacity+ of them until they're
+ * read with #recv, #recv_batch, etc. Events that arrive while the buffer is full
+ * are dropped and counted (see #reader_stats). While the reader is running, the
+ * node can't be waited on with Zyre.wait or a Zyre::Poller or registered with a
+ * Zyre::Reactor, since the reader consumes its socket; trying to raises a
+ * RuntimeError. For the same reason, a reader can't be started while another
+ * thread or fiber is waiting on the node, or a running reactor has it registered.
+ *
+ */
+static VALUE
+rzyre_node_start_reader( int argc, VALUE *argv, VALUE self )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
+	VALUE opts, capacity_arg = Qundef;
+	long capacity = 1024;
+
+	rb_scan_args( argc, argv, "0:", &opts );
+	if ( !NIL_P(opts) ) rb_get_kwargs( opts, &id_capacity, 0, 1, &capacity_arg );
+
+	if ( capacity_arg != Qundef ) capacity = NUM2LONG( capacity_arg );
+	if ( capacity < 1 )
+		rb_raise( rb_eArgError, "capacity must be greater than 0" );
+	if ( rzyre_node_reader(self) )
+		rb_raise( rb_eRuntimeError, "the node already has a reader" );
+	if ( ptr->polled )
+		rb_raise( rb_eRuntimeError, "%+"PRIsVALUE" is being polled by something else", self );
+
+	rzyre_log_obj( self, "debug", "Starting a background reader with room for %ld events.", capacity );
+	ptr->reader = rzyre_reader_new( ptr, capacity );
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    node.stop_reader   -> true or false
+ *
+ * Stop the node's background reader, if it has one. Events it has already read
+ * are returned by #recv before any more are read from the node directly. Returns
+ * +false+ if there was no reader running.
+ *
+ */
+static VALUE
+rzyre_node_stop_reader( VALUE self )
+{
+	rzyre_reader_t *reader = rzyre_node_reader( self );
+	rzyre_reader_counters_t counters;
+
+	if ( !reader ) return Qfalse;
+
+	rzyre_reader_counters( reader, &counters );
+	if ( !counters.running ) return Qfalse;
+
+	rzyre_reader_stop( reader );
+	rzyre_node_reader( self );
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    node.reader_stats   -> hash or nil
+ *
+ * Returns a Hash of the counters of the node's background reader: its +capacity+,
+ * the number of events currently buffered (+depth+), the most that have been
+ * buffered at once (+high_water+), the number of events dropped because the
+ * buffer was full (+overflows+), and whether it's still +running+. Returns +nil+
+ * if the node doesn't have a reader.
+ *
+ */
+static VALUE
+rzyre_node_reader_stats( VALUE self )
+{
+	rzyre_reader_t *reader = rzyre_node_reader( self );
+	rzyre_reader_counters_t counters;
+	VALUE rval;
+
+	if ( !reader ) return Qnil;
+
+	rzyre_reader_counters( reader, &counters );
+
+	rval = rb_hash_new();
+	rb_hash_aset( rval, ID2SYM(rb_intern("capacity")), SIZET2NUM(counters.capacity) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("depth")), SIZET2NUM(counters.depth) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("high_water")), SIZET2NUM(counters.high_water) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("overflows")), ULONG2NUM(counters.overflows) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("running")), counters.running ? Qtrue : Qfalse );
+
+	return rval;
+}
+
+
+/*
+ * Return the given +members+ of one of the sets of a filter as a frozen Array of
+ * frozen Strings, or nil if they're undefined or nil.
+ */
+static VALUE
+rzyre_node_filter_set( VALUE members )
+{
+	VALUE rval;
+
+	if ( members == Qundef || NIL_P(members) ) return Qnil;
+
+	members = rb_Array( members );
+	rval = rb_ary_new_capa( RARRAY_LEN(members) );
+	for ( long i = 0 ; i < RARRAY_LEN(members) ; i++ ) {
+		VALUE member = RARRAY_AREF( members, i );
+
+		StringValueCStr( member );
+		rb_ary_push( rval, rb_str_new_frozen(member) );
+	}
+
+	return rb_obj_freeze( rval );
+}
+
+
+/*
+ * call-seq:
+ *    node.filter = config
+ *
+ * Filter the events the node receives before they're wrapped in Zyre::Events,
+ * so the ones that don't pass are destroyed without allocating any Ruby objects
+ * for them. The +config+ is a Hash with any of the following keys, or +nil+ to
+ * remove the filter:
+ *
+ * [:types]
+ *   The types of events to pass, as names (e.g., :WHISPER) or Zyre::Event
+ *   subclasses.
+ * [:allow_peers]
+ *   Only pass events from peers with these UUIDs.
+ * [:deny_peers]
+ *   Don't pass events from peers with these UUIDs.
+ * [:groups]
+ *   Only pass SHOUT, JOIN, and LEAVE events for these groups.
+ *
+ * The filter is applied without the GVL by whatever reads the node's events:
+ * #recv, #recv_batch, a background reader, or a Zyre::Reactor. Events that a
+ * #local_directory needs still update it even if they don't pass. Note that
+ * Zyre.wait and Zyre::Poller wake for events the filter will drop. See
+ * #filter_stats for counts of the events it has dropped.
+ *
+ *    node.filter = { types: [:WHISPER, :SHOUT], groups: ['telemetry'] }
+ *
+ */
+static VALUE
+rzyre_node_filter_eq( VALUE self, VALUE config )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
+	rzyre_event_filter_t *filter = NULL, *old_filter;
+	VALUE kwvals[4] = { Qundef, Qundef, Qundef, Qundef };
+	VALUE types, allow_peers, deny_peers, groups;
+	unsigned int mask = RZYRE_EVENT_TYPE_ALL;
+
+	if ( !NIL_P(config) ) {
+		config = rb_obj_freeze( rb_hash_dup(rb_convert_type(config, T_HASH, "Hash", "to_hash")) );
+		rb_get_kwargs( rb_hash_dup(config), filter_keyword_ids, 0, 4, kwvals );
+
+		if ( kwvals[0] != Qundef && !NIL_P(kwvals[0]) ) {
+			types = rb_Array( kwvals[0] );
+			mask = 0;
+			for ( long i = 0 ; i < RARRAY_LEN(types) ; i++ )
+				mask |= rzyre_event_type_bit_from_value( RARRAY_AREF(types, i) );
+		}
+
+		allow_peers = rzyre_node_filter_set( kwvals[1] );
+		deny_peers = rzyre_node_filter_set( kwvals[2] );
+		groups = rzyre_node_filter_set( kwvals[3] );
+
+		filter = rzyre_filter_new( mask, allow_peers, deny_peers, groups );
+		RB_GC_GUARD( allow_peers );
+		RB_GC_GUARD( deny_peers );
+		RB_GC_GUARD( groups );
+	}
+
+	pthread_mutex_lock( &ptr->filter_mutex );
+	old_filter = ptr->filter;
+	ptr->filter = filter;
+	pthread_mutex_unlock( &ptr->filter_mutex );
+
+	rzyre_filter_destroy( &old_filter );
+	ptr->filter_config = config;
+
+	return config;
+}
+
+
+/*
+ * call-seq:
+ *    node.filter   -> hash or nil
+ *
+ * Returns the (frozen) Hash the node's event filter was set from, or +nil+ if it
+ * doesn't have one. See #filter=.
+ *
+ */
+static VALUE
+rzyre_node_filter( VALUE self )
+{
+	return rzyre_get_node_data( self )->filter_config;
+}
+
+
+/*
+ * call-seq:
+ *    node.filter_stats   -> hash
+ *
+ * Returns a Hash of the number of events the node's filter has dropped because
+ * of their +types+, their +peers+, and their +groups+. The counts include events
+ * dropped by earlier filters.
+ *
+ *    node.filter_stats  # => {types: 1840, peers: 12, groups: 0}
+ *
+ */
+static VALUE
+rzyre_node_filter_stats( VALUE self )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
+	rzyre_filter_counters_t counters;
+	VALUE rval = rb_hash_new();
+
+	pthread_mutex_lock( &ptr->filter_mutex );
+	counters = ptr->filtered;
+	pthread_mutex_unlock( &ptr->filter_mutex );
+
+	rb_hash_aset( rval, ID2SYM(rb_intern("types")), ULONG2NUM(counters.types) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("peers")), ULONG2NUM(counters.peers) );
+	rb_hash_aset( rval, ID2SYM(rb_intern("groups")), ULONG2NUM(counters.groups) );
+
+	return rval;
+}
+
+
+/*
+ * call-seq:
+ *    node.whisper( peer_uuid, *messages )  -> int
+ *
+ * Send a +message+ to a single +peer+ specified as a UUID string. Each of the
+ * +messages+ becomes one frame, and may contain arbitrary binary data.
+ *
+ */
+static VALUE
+rzyre_node_whisper( int argc, VALUE *argv, VALUE self )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
+	actor_call_t call = { ptr->node };
+	VALUE peer_uuid, msg_parts;
+
+	rb_scan_args( argc, argv, "1*", &peer_uuid, &msg_parts );
+
+	call.arg1 = StringValueCStr( peer_uuid );
+	call.msg = rzyre_make_zmsg_from( msg_parts, ptr->zero_copy );
+	call.compress = ptr->compression;
+	call.compress_above = ptr->compression_threshold;
+
+	rb_str_locktmp( peer_uuid );
+	rzyre_node_call_actor( self, rzyre_node_whisper_without_gvl, &call );
+	rb_str_unlocktmp( peer_uuid );
+	rzyre_compression_stats_add( &ptr->compressed, &call.stats );
+
+	if ( call.msg ) zmsg_destroy( &call.msg );
+
+	return call.result ? Qtrue : Qfalse;
+}
+
+
+/*
+ * call-seq:
+ *    node.shout( group, *messages )   -> int
+ *
+ * Send +message+ to a named +group+. Each of the +messages+ becomes one frame,
+ * and may contain arbitrary binary data.
+ *
+ */
+static VALUE
+rzyre_node_shout( int argc, VALUE *argv, VALUE self )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
+	actor_call_t call = { ptr->node };
+	VALUE group, msg_parts;
+
+	rb_scan_args( argc, argv, "1*", &group, &msg_parts );
+
+	call.arg1 = StringValueCStr( group );
+	call.msg = rzyre_make_zmsg_from( msg_parts, ptr->zero_copy );
+	call.compress = ptr->compression;
+	call.compress_above = ptr->compression_threshold;
+
+	rb_str_locktmp( group );
+	rzyre_node_call_actor( self, rzyre_node_shout_without_gvl, &call );
+	rb_str_unlocktmp( group );
+	rzyre_compression_stats_add( &ptr->compressed, &call.stats );
+
+	if ( call.msg ) zmsg_destroy( &call.msg );
+
+	return call.result ? Qtrue : Qfalse;
+}
+
+
+/*
+ * Encode +obj+ into a single-frame message, then send it with the given actor
+ * +func+ to +target+.
+ */
+static VALUE
+rzyre_node_send_encoded( VALUE self, VALUE target, VALUE obj, void *(*func)(void *) )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
+	actor_call_t call = { ptr->node };
+	zframe_t *frame;
+
+	call.arg1 = StringValueCStr( target );
+	call.compress = ptr->compression;
+	call.compress_above = ptr->compression_threshold;
+	frame = rzyre_encode_frame( obj );
+	call.msg = zmsg_new();
+	zmsg_append( call.msg, &frame );
+
+	rb_str_locktmp( target );
+	rzyre_node_call_actor( self, func, &call );
+	rb_str_unlocktmp( target );
+	rzyre_compression_stats_add( &ptr->compressed, &call.stats );
+
+	if ( call.msg ) zmsg_destroy( &call.msg );
+
+	return call.result ? Qtrue : Qfalse;
+}
+
+
+/*
+ * call-seq:
+ *    node.whisper_encoded( peer_uuid, obj )  -> int
+ *
+ * Encode +obj+ as MessagePack (see Zyre::Codec) directly into the frame of a
+ * message, and send it to a single +peer+ specified as a UUID string. The
+ * receiver can decode it with Zyre::Event#decoded_msg.
+ *
+ */
+static VALUE
+rzyre_node_whisper_encoded( VALUE self, VALUE peer_uuid, VALUE obj )
+{
+	return rzyre_node_send_encoded( self, peer_uuid, obj, rzyre_node_whisper_without_gvl );
+}
+
+
+/*
+ * call-seq:
+ *    node.shout_encoded( group, obj )  -> int
+ *
+ * Encode +obj+ as MessagePack (see Zyre::Codec) directly into the frame of a
+ * message, and send it to a named +group+. The receivers can decode it with
+ * Zyre::Event#decoded_msg.
+ *
+ */
+static VALUE
+rzyre_node_shout_encoded( VALUE self, VALUE group, VALUE obj )
+{
+	return rzyre_node_send_encoded( self, group, obj, rzyre_node_shout_without_gvl );
+}
+
+
+// One message of a batch send
+typedef struct {
+	char *target;
+	zmsg_t *msg;
+	int result;
+} send_batch_item_t;
+
+// Struct for passing arguments through rb_protect and rb_thread_call_without_gvl
+// for batch sends
+typedef struct {
+	rzyre_node_data_t *node;
+	VALUE pairs;
+	long length;
+	int shout;
+	send_batch_item_t *items;
+	long count;
+	rzyre_compression_stats_t stats;
+} send_batch_call_t;
+
+
+/*
+ * Build the targets and zmsgs for a batch send from the call's Array of pairs.
+ */
+static VALUE
+rzyre_node_build_send_batch( VALUE batch_call )
+{
+	send_batch_call_t *call = (send_batch_call_t *)batch_call;
+	VALUE pair, target;
+
+	for ( long i = 0 ; i < call->length ; i++ ) {
+		pair = rb_check_array_type( rb_ary_entry(call->pairs, i) );
+		if ( NIL_P(pair) || RARRAY_LEN(pair) != 2 )
+			rb_raise( rb_eArgError, "expected a [target, message parts] pair at index %ld", i );
+
+		target = rb_ary_entry( pair, 0 );
+		call->items[ i ].target = strdup( StringValueCStr(target) );
+		call->items[ i ].msg = NULL;
+		call->items[ i ].result = -1;
+		call->count++;
+
+		call->items[ i ].msg = rzyre_make_zmsg_from( rb_ary_entry(pair, 1), call->node->zero_copy );
+	}
+
+	return Qtrue;
+}
+
+
+/*
+ * Send every message of a batch; called without the GVL. Each message is
+ * compressed before the node's actor pipe is locked to send it.
+ */
+static void *
+rzyre_node_send_batch_without_gvl( void *batch_call )
+{
+	send_batch_call_t *call = (send_batch_call_t *)batch_call;
+	zyre_t *node = call->node->node;
+	send_batch_item_t *item;
+
+	for ( long i = 0 ; i < call->count ; i++ ) {
+		item = &call->items[ i ];
+
+		if ( call->node->compression )
+			rzyre_compress_msg( item->msg, call->node->compression_threshold, &call->stats );
+
+		pthread_mutex_lock( &call->node->actor_mutex );
+		if ( call->shout ) {
+			item->result = zyre_shout( node, item->target, &item->msg );
+		} else {
+			item->result = zyre_whisper( node, item->target, &item->msg );
+		}
+		pthread_mutex_unlock( &call->node->actor_mutex );
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Send a batch of messages to groups (if +shout+ is true) or peers.
+ */
+static VALUE
+rzyre_node_send_batch( VALUE self, VALUE pairs, int shout )
+{
+	send_batch_call_t call;
+	VALUE tmpbuf, rval;
+	int state;
+
+	call.node = rzyre_get_node_data( self );
+	// Copy the pairs so conversions of their contents can't change them
+	call.pairs = rb_ary_dup( rb_Array(pairs) );
+	call.length = RARRAY_LEN( call.pairs );
+	call.shout = shout;
+	call.count = 0;
+	memset( &call.stats, 0, sizeof call.stats );
+	call.items = ALLOCV_N( send_batch_item_t, tmpbuf, call.length );
+
+	rb_protect( rzyre_node_build_send_batch, (VALUE)&call, &state );
+
+	// No unblocking function for the same reason as rzyre_node_call_actor()
+	if ( !state ) {
+		rzyre_log_obj( self, "debug", "Sending a batch of %ld messages.", call.count );
+		rb_thread_call_without_gvl( rzyre_node_send_batch_without_gvl, (void *)&call, NULL, NULL );
+		rzyre_compression_stats_add( &call.node->compressed, &call.stats );
+	}
+
+	rval = rb_ary_new_capa( call.count );
+	for ( long i = 0 ; i < call.count ; i++ ) {
+		if ( call.items[i].msg ) zmsg_destroy( &call.items[i].msg );
+		free( call.items[i].target );
+		rb_ary_push( rval, INT2FIX(call.items[i].result) );
+	}
+
+	ALLOCV_END( tmpbuf );
+	RB_GC_GUARD( call.pairs );
+	if ( state ) rb_jump_tag( state );
+
+	return rval;
+}
+
+
+/*
+ * call-seq:
+ *    node.whisper_batch( pairs )   -> array
+ *
+ * Send a batch of messages to peers with a single release of the GVL. The +pairs+
+ * are an Array of <tt>[ peer_uuid, messages ]</tt> pairs, where +messages+ is a
+ * String or an Array of Strings to send as the frames of one message. Returns an
+ * Array of the result codes of each send; 0 means the message was sent.
+ *
+ *    node.whisper_batch([
+ *      [ peer1, 'status' ],
+ *      [ peer2, ['status', json] ],
+ *    ])   # => [0, 0]
+ *
+ */
+static VALUE
+rzyre_node_whisper_batch( VALUE self, VALUE pairs )
+{
+	return rzyre_node_send_batch( self, pairs, FALSE );
+}
+
+
+/*
+ * call-seq:
+ *    node.shout_batch( pairs )   -> array
+ *
+ * Send a batch of messages to groups with a single release of the GVL. The +pairs+
+ * are an Array of <tt>[ group, messages ]</tt> pairs, where +messages+ is a String
+ * or an Array of Strings to send as the frames of one message. Returns an Array of
+ * the result codes of each send; 0 means the message was sent.
+ *
+ */
+static VALUE
+rzyre_node_shout_batch( VALUE self, VALUE pairs )
+{
+	return rzyre_node_send_batch( self, pairs, TRUE );
+}
+
+
+/*
+ * call-seq:
+ *    node.peers -> array
+ *
+ * Return an Array of current peer UUIDs. If the node has a local directory, the
+ * peers are read from it instead of asking the node's actor.
+ *
+ */
+static VALUE
+rzyre_node_peers( VALUE self )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+	rzyre_node_directory_t *dir = rzyre_get_node_data( self )->directory;
+
+	if ( dir ) return rzyre_hash_keys( dir->peers );
+
+	assert( call.node );
+	rzyre_node_call_actor( self, rzyre_node_peers_without_gvl, &call );
+
+	return rzyre_ary_from_zlist( (zlist_t **)&call.rval );
+}
+
+
+/*
+ * call-seq:
+ *    node.peers_by_group( group ) -> array
+ *
+ * Return an Array of the current peers in the specified +group+. If the node has
+ * a local directory, the peers are read from it instead of asking the node's
+ * actor.
+ *
+ */
+static VALUE
+rzyre_node_peers_by_group( VALUE self, VALUE group )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+	rzyre_node_directory_t *dir = rzyre_get_node_data( self )->directory;
+
+	assert( call.node );
+	call.arg1 = StringValueCStr( group );
+
+	if ( dir ) {
+		VALUE members = rb_hash_lookup2( dir->groups, rzyre_interned_str(call.arg1), Qnil );
+		return NIL_P( members ) ? rb_ary_new() : rzyre_hash_keys( members );
+	}
+
+	rb_str_locktmp( group );
+	rzyre_node_call_actor( self, rzyre_node_peers_by_group_without_gvl, &call );
+	rb_str_unlocktmp( group );
+
+	return rzyre_ary_from_zlist( (zlist_t **)&call.rval );
+}
+
+
+/*
+ * call-seq:
+ *    node.own_groups -> array
+ *
+ * Return an Array of the names of the receiving node's current groups. If the node
+ * has a local directory, the groups are read from it instead of asking the node's
+ * actor.
+ *
+ */
+static VALUE
+rzyre_node_own_groups( VALUE self )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+	rzyre_node_directory_t *dir = rzyre_get_node_data( self )->directory;
+
+	if ( dir ) return rzyre_hash_keys( dir->own_groups );
+
+	rzyre_node_call_actor( self, rzyre_node_own_groups_without_gvl, &call );
+
+	return rzyre_ary_from_zlist( (zlist_t **)&call.rval );
+}
+
+
+/*
+ * call-seq:
+ *    node.peer_groups  -> array
+ *
+ * Return an Array of the names of groups known through connected peers. If the node
+ * has a local directory, the groups are read from it instead of asking the node's
+ * actor.
+ *
+ */
+static VALUE
+rzyre_node_peer_groups( VALUE self )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+	rzyre_node_directory_t *dir = rzyre_get_node_data( self )->directory;
+
+	if ( dir ) return rzyre_hash_keys( dir->groups );
+
+	rzyre_node_call_actor( self, rzyre_node_peer_groups_without_gvl, &call );
+
+	return rzyre_ary_from_zlist( (zlist_t **)&call.rval );
+}
+
+
+/*
+ * Set whether the node's local directory needs to see the events its filter drops.
+ * Code reading the node's events without the GVL only needs to know that, and
+ * must not touch the directory itself.
+ */
+static void
+rzyre_node_set_observing( rzyre_node_data_t *ptr, int observing )
+{
+	pthread_mutex_lock( &ptr->filter_mutex );
+	ptr->observing = observing;
+	pthread_mutex_unlock( &ptr->filter_mutex );
+}
+
+
+// The peers and groups a node's actor knows about, for seeding its local directory
+typedef struct {
+	zlist_t *peers;         //  The UUIDs of its peers
+	zlist_t *groups;        //  The names of its peers' groups
+	zlist_t *members;       //  The UUIDs of the peers in each group, in the same order
+	zlist_t *own_groups;    //  The names of its own groups
+} directory_seed_t;
+
+
+/*
+ * Ask the node's actor for everything needed to seed its local directory, as one
+ * exchange so the answers agree with each other; called without the GVL.
+ */
+static void *
+rzyre_node_directory_seed_without_gvl( void *call_ptr )
+{
+	actor_call_t *call = (actor_call_t *)call_ptr;
+	directory_seed_t *seed = (directory_seed_t *)call->rval;
+	zlist_t *members;
+	char *group;
+
+	seed->peers = zyre_peers( call->node );
+	seed->groups = zyre_peer_groups( call->node );
+	seed->own_groups = zyre_own_groups( call->node );
+	seed->members = zlist_new();
+
+	// The actor doesn't answer for groups which have emptied since it was asked
+	for ( group = zlist_first(seed->groups) ; group ; group = zlist_next(seed->groups) ) {
+		if ( !(members = zyre_peers_by_group(call->node, group)) ) members = zlist_new();
+		zlist_append( seed->members, members );
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Free the lists in the given +seed+.
+ */
+static void
+rzyre_directory_seed_destroy( directory_seed_t *seed )
+{
+	zlist_t *members;
+
+	while ( (members = (zlist_t *)zlist_pop(seed->members)) ) zlist_destroy( &members );
+
+	zlist_destroy( &seed->members );
+	zlist_destroy( &seed->own_groups );
+	zlist_destroy( &seed->groups );
+	zlist_destroy( &seed->peers );
+}
+
+
+/*
+ * Fill the given (empty) directory +dir+ from the peers and groups in the +seed+.
+ * Doesn't release the GVL, so nothing else can change the directory meanwhile.
+ */
+static void
+rzyre_directory_seed( rzyre_node_directory_t *dir, directory_seed_t *seed )
+{
+	zlist_t *members;
+	char *item, *group;
+
+	for ( item = zlist_first(seed->peers) ; item ; item = zlist_next(seed->peers) ) {
+		rzyre_directory_add_peer( dir, rzyre_interned_str(item) );
+	}
+
+	for ( group = zlist_first(seed->groups), members = zlist_first(seed->members) ;
+		group && members ;
+		group = zlist_next(seed->groups), members = zlist_next(seed->members) )
+	{
+		for ( item = zlist_first(members) ; item ; item = zlist_next(members) ) {
+			rzyre_directory_add_member( dir, rzyre_interned_str(item), rzyre_interned_str(group) );
+		}
+	}
+
+	for ( item = zlist_first(seed->own_groups) ; item ; item = zlist_next(seed->own_groups) ) {
+		rb_hash_aset( dir->own_groups, rzyre_interned_str(item), Qtrue );
+	}
+}
+
+
+/*
+ * call-seq:
+ *    node.local_directory = true or false
+ *
+ * If set to +true+, the node keeps a local directory of its peers and their
+ * groups, seeded from the node's actor and then kept up to date from the ENTER,
+ * EXIT, JOIN, and LEAVE events it receives. While the directory is enabled, #peers,
+ * #peers_by_group, #own_groups, and #peer_groups are answered from it without a
+ * round trip to the actor, and #peer? and #peer_in_group? are constant-time.
+ * The names, addresses, and headers peers announce in their ENTER events are
+ * also kept for #peer_info and #peer_headers, and used by #peer_address and
+ * #peer_header_value.
+ * Since the directory is only updated as events are received, it's only as
+ * current as the last call to #recv (or one of its variants). Defaults to +false+.
+ *
+ */
+static VALUE
+rzyre_node_local_directory_eq( VALUE self, VALUE flag )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( self );
+	rzyre_node_directory_t *dir = ptr->directory;
+
+	if ( !RTEST(flag) ) {
+		rzyre_node_set_observing( ptr, FALSE );
+		if ( dir ) {
+			ptr->directory = NULL;
+			xfree( dir );
+		}
+	}
+	else if ( RTEST(flag) && !dir ) {
+		actor_call_t call = { ptr->node };
+		directory_seed_t seed;
+
+		// Ask the actor first, since other threads can run while it's being asked
+		call.rval = &seed;
+		rzyre_node_call_actor( self, rzyre_node_directory_seed_without_gvl, &call );
+
+		// Unless one of them enabled it in the meantime, create the directory and
+		// fill it without releasing the GVL again. It's attached to the node before
+		// its Hashes are created so they're marked as soon as they exist.
+		if ( !ptr->directory ) {
+			dir = ALLOC( rzyre_node_directory_t );
+			dir->peers = dir->groups = dir->own_groups = dir->peer_info = Qnil;
+			dir->generation = 0;
+			ptr->directory = dir;
+
+			dir->peers = rb_hash_new();
+			dir->groups = rb_hash_new();
+			dir->own_groups = rb_hash_new();
+			dir->peer_info = rb_hash_new();
+
+			rzyre_directory_seed( dir, &seed );
+		}
+
+		rzyre_directory_seed_destroy( &seed );
+		rzyre_node_set_observing( ptr, TRUE );
+	}
+
+	return flag;
+}
+
+
+/*
+ * call-seq:
+ *    node.local_directory?   -> true or false
+ *
+ * Returns +true+ if the node is keeping a local directory of its peers.
+ *
+ */
+static VALUE
+rzyre_node_local_directory_p( VALUE self )
+{
+	return rzyre_get_node_data( self )->directory ? Qtrue : Qfalse;
+}
+
+
+/*
+ * call-seq:
+ *    node.directory_generation   -> integer
+ *
+ * Return a number that changes whenever the membership recorded in the node's
+ * local directory changes, so derived data can be cached until it does. Returns 0
+ * if the node doesn't have a local directory.
+ *
+ */
+static VALUE
+rzyre_node_directory_generation( VALUE self )
+{
+	rzyre_node_directory_t *dir = rzyre_get_node_data( self )->directory;
+
+	return ULONG2NUM( dir ? dir->generation : 0 );
+}
+
+
+/*
+ * call-seq:
+ *    node.peer?( peer_uuid )   -> true or false
+ *
+ * Returns +true+ if the peer with the given +peer_uuid+ is currently connected.
+ *
+ */
+static VALUE
+rzyre_node_peer_p( VALUE self, VALUE peer_uuid )
+{
+	rzyre_node_directory_t *dir = rzyre_get_node_data( self )->directory;
+
+	if ( dir ) {
+		StringValue( peer_uuid );
+		return rb_hash_lookup2( dir->peers, peer_uuid, Qundef ) == Qundef ? Qfalse : Qtrue;
+	}
+
+	return rb_ary_includes( rzyre_node_peers(self), peer_uuid );
+}
+
+
+/*
+ * call-seq:
+ *    node.peer_in_group?( peer_uuid, group )   -> true or false
+ *
+ * Returns +true+ if the peer with the given +peer_uuid+ is a member of the
+ * specified +group+.
+ *
+ */
+static VALUE
+rzyre_node_peer_in_group_p( VALUE self, VALUE peer_uuid, VALUE group )
+{
+	rzyre_node_directory_t *dir = rzyre_get_node_data( self )->directory;
+
+	if ( dir ) {
+		VALUE members = rb_hash_lookup2( dir->groups, rzyre_interned_str(StringValueCStr(group)), Qnil );
+
+		StringValue( peer_uuid );
+		if ( NIL_P(members) ) return Qfalse;
+		return rb_hash_lookup2( members, peer_uuid, Qundef ) == Qundef ? Qfalse : Qtrue;
+	}
+
+	return rb_ary_includes( rzyre_node_peers_by_group(self, group), peer_uuid );
+}
+
+
+/*
+ * Return the frozen Hash of the information the peer with the given +peer_uuid+
+ * announced in its ENTER event if the node has a local directory and it has seen
+ * that event, or +nil+ otherwise.
+ */
+static VALUE
+rzyre_node_cached_peer_info( VALUE self, VALUE peer_uuid )
+{
+	rzyre_node_directory_t *dir = rzyre_get_node_data( self )->directory;
+
+	if ( !dir ) return Qnil;
+	return rb_hash_lookup2( dir->peer_info, StringValue(peer_uuid), Qnil );
+}
+
+
+/*
+ * call-seq:
+ *    node.peer_info( peer_uuid )   -> hash or nil
+ *
+ * Return a frozen Hash of the <tt>:uuid</tt>, <tt>:name</tt>, <tt>:address</tt>,
+ * and <tt>:headers</tt> the peer with the given +peer_uuid+ announced when it
+ * entered the network. Requires a #local_directory; returns +nil+ if there isn't
+ * one or if it hasn't seen the peer's ENTER event (e.g., if the peer entered
+ * before the directory was enabled).
+ *
+ */
+static VALUE
+rzyre_node_peer_info( VALUE self, VALUE peer_uuid )
+{
+	return rzyre_node_cached_peer_info( self, peer_uuid );
+}
+
+
+/*
+ * call-seq:
+ *    node.peer_headers( peer_uuid )   -> hash or nil
+ *
+ * Return a frozen Hash of the headers the peer with the given +peer_uuid+
+ * announced when it entered the network. Requires a #local_directory; returns
+ * +nil+ under the same conditions as #peer_info.
+ *
+ */
+static VALUE
+rzyre_node_peer_headers( VALUE self, VALUE peer_uuid )
+{
+	VALUE info = rzyre_node_cached_peer_info( self, peer_uuid );
+
+	return NIL_P( info ) ? Qnil : rb_hash_aref( info, sym_headers );
+}
+
+
+/*
+ * call-seq:
+ *    node.peer_address( peer_uuid ) -> str
+ *
+ * Return the endpoint of a connected +peer+.
+ * Returns nil if peer does not exist. If the node has a local directory that has
+ * seen the peer's ENTER event, the address is read from it instead of asking the
+ * node's actor.
+ *
+ */
+static VALUE
+rzyre_node_peer_address( VALUE self, VALUE peer_uuid )
+{
+	actor_call_t call = { rzyre_get_node(self) };
+	VALUE info = rzyre_node_cached_peer_info( self, peer_uuid );
+	char *address;
+	VALUE rval = Qnil;
+
+	call.arg1 = StringValueCStr( peer_uuid );
+	if ( !NIL_P(info) ) return rb_hash_aref( info, sym_address );
+
+	rb_str_locktmp( peer_uuid );
+	rzyre_node_call_actor( self, rzyre_node_peer_address_without_gvl, &call );
+	rb_str_unlocktmp( peer_uuid );
+
+	address = (char *)call.rval;
+	if ( strnlen(address, BUFSIZ) ) {
 		rval = rb_str_new2( address );
 	}
 
@@ -729,21 +2209,31 @@ rzyre_node_peer_address( VALUE self, VALUE peer_uuid )
  *    node.peer_header_value( peer_id, header_name )    -> str
  *
  * Return the value of a header of a conected peer. Returns nil if
- * peer or key doesn't exist.
+ * peer or key doesn't exist. If the node has a local directory that has seen the
+ * peer's ENTER event, the header is read from it instead of asking the node's
+ * actor.
  *
  */
 static VALUE
 rzyre_node_peer_header_value( VALUE self, VALUE peer_id, VALUE header_name )
 {
-	zyre_t *ptr = rzyre_get_node( self );
-	const char *peer_id_str = StringValueCStr( peer_id );
-	const char *header_name_str = StringValueCStr( header_name );
+	actor_call_t call = { rzyre_get_node(self) };
+	VALUE info = rzyre_node_cached_peer_info( self, peer_id );
 	char *res;
 	VALUE rval = Qnil;
 
-	res = zyre_peer_header_value( ptr, peer_id_str, header_name_str );
+	call.arg1 = StringValueCStr( peer_id );
+	call.arg2 = StringValueCStr( header_name );
+	if ( !NIL_P(info) ) return rb_hash_lookup2( rb_hash_aref(info, sym_headers), header_name, Qnil );
+
+	rb_str_locktmp( peer_id );
+	rb_str_locktmp( header_name );
+	rzyre_node_call_actor( self, rzyre_node_peer_header_value_without_gvl, &call );
+	rb_str_unlocktmp( header_name );
+	rb_str_unlocktmp( peer_id );
 
 	// TODO: Encoding + frozen
+	res = (char *)call.rval;
 	if ( res ) {
 		rval = rb_str_new2( res );
 		xfree( res );
@@ -765,12 +2255,105 @@ rzyre_node_print( VALUE self )
 {
 	zyre_t *ptr = rzyre_get_node( self );
 
+	rzyre_node_lock_actor( self );
 	zyre_print( ptr );
+	rzyre_node_unlock_actor( self );
 
 	return Qtrue;
 }
 
 
+/*
+ * Return an IO for the file descriptor ZeroMQ uses to signal that the +node+'s
+ * socket might have changed state (ZMQ_FD). The IO doesn't close the descriptor,
+ * which belongs to ZeroMQ.
+ */
+VALUE
+rzyre_node_io( VALUE node )
+{
+	rzyre_node_data_t *ptr = rzyre_get_node_data( node );
+
+	if ( NIL_P(ptr->io) ) {
+		int fd = zsock_fd( zyre_socket(ptr->node) );
+		VALUE io = rb_funcall( rb_cIO, rb_intern("for_fd"), 1, INT2FIX(fd) );
+
+		rb_funcall( io, rb_intern("autoclose="), 1, Qfalse );
+		ptr->io = io;
+	}
+
+	return ptr->io;
+}
+
+
+/*
+ * Wait up to +timeout+ milliseconds (or indefinitely if +timeout+ is -1) for any
+ * of the +count+ +nodes+ to have input without blocking the current thread, by
+ * waiting on their ZMQ_FDs through the current Fiber scheduler. The +items+ should
+ * hold the nodes' sockets; their +revents+ are set like zmq_poll() does, and the
+ * number of nodes with input is returned. Must only be called when
+ * RZYRE_FIBER_SCHEDULER_P() is true.
+ *
+ * ZMQ_FD is edge-triggered: it only becomes readable when the socket's state
+ * changes, and stays quiet if messages were already queued when we started
+ * waiting. So ZMQ_EVENTS is checked before every wait and after every wakeup,
+ * and a wakeup without ZMQ_POLLIN just means waiting again.
+ */
+int
+rzyre_fiber_poll( VALUE *nodes, zmq_pollitem_t *items, int count, int timeout )
+{
+#if defined(HAVE_RB_FIBER_SCHEDULER_CURRENT) && defined(HAVE_RB_IO_WAIT)
+	const int64_t deadline = zclock_mono() + timeout;
+	VALUE ios = Qnil, wait_timeout = Qnil;
+	int ready, i;
+
+	for ( ;; ) {
+		ready = 0;
+		for ( i = 0 ; i < count ; i++ ) {
+			items[ i ].revents = ( zsock_events(items[i].socket) & ZMQ_POLLIN ) ? ZMQ_POLLIN : 0;
+			if ( items[i].revents ) ready++;
+		}
+
+		if ( ready ) return ready;
+
+		if ( timeout >= 0 ) {
+			int64_t remaining = deadline - zclock_mono();
+			if ( remaining <= 0 ) return 0;
+			wait_timeout = DBL2NUM( remaining / 1000.0 );
+		}
+
+		// A single IO can be waited on directly; several have to go through
+		// IO.select, which is only scheduler-aware in Rubies which have the
+		// #io_select scheduler hook.
+		if ( count == 1 ) {
+			rb_io_wait( rzyre_node_io(nodes[0]), RB_INT2NUM(RUBY_IO_READABLE), wait_timeout );
+		} else {
+			if ( NIL_P(ios) ) {
+				ios = rb_ary_new_capa( count );
+				for ( i = 0 ; i < count ; i++ ) rb_ary_push( ios, rzyre_node_io(nodes[i]) );
+			}
+			rb_funcall( rb_cIO, rb_intern("select"), 4, ios, Qnil, Qnil, wait_timeout );
+		}
+	}
+#else
+	rb_notimplement();
+#endif
+}
+
+
+/*
+ * Wait up to +timeout+ milliseconds (or indefinitely if +timeout+ is -1) for the
+ * given +node+ to have input, via the current Fiber scheduler. Returns true if it
+ * does.
+ */
+int
+rzyre_node_fiber_wait( VALUE node, int timeout )
+{
+	zmq_pollitem_t item = { zsock_resolve(zyre_socket(rzyre_get_node(node))), 0, ZMQ_POLLIN, 0 };
+
+	return rzyre_fiber_poll( &node, &item, 1, timeout ) > 0;
+}
+
+
 /*
  * Node class init
  */
@@ -791,10 +2374,23 @@ rzyre_init_node( void )
 	 * Refs:
 	 * - https://github.com/zeromq/zyre#readme
 	 */
-	rzyre_cZyreNode = rb_define_class_under( rzyre_mZyre, "Node", rb_cData );
+	rzyre_cZyreNode = rb_define_class_under( rzyre_mZyre, "Node", rb_cObject );
 
 	rb_define_alloc_func( rzyre_cZyreNode, rzyre_node_alloc );
 
+	sym_uuid = ID2SYM( rb_intern("uuid") );
+	sym_name = ID2SYM( rb_intern("name") );
+	sym_address = ID2SYM( rb_intern("address") );
+	sym_headers = ID2SYM( rb_intern("headers") );
+
+	id_timeout = rb_intern( "timeout" );
+	id_capacity = rb_intern( "capacity" );
+
+	filter_keyword_ids[0] = rb_intern( "types" );
+	filter_keyword_ids[1] = rb_intern( "allow_peers" );
+	filter_keyword_ids[2] = rb_intern( "deny_peers" );
+	filter_keyword_ids[3] = rb_intern( "groups" );
+
 	rb_define_protected_method( rzyre_cZyreNode, "initialize", rzyre_node_initialize, -1 );
 
 	rb_define_method( rzyre_cZyreNode, "uuid", rzyre_node_uuid, 0 );
@@ -812,6 +2408,13 @@ rzyre_init_node( void )
 	rb_define_method( rzyre_cZyreNode, "endpoint=", rzyre_node_endpoint_eq, 1 );
 	rb_define_method( rzyre_cZyreNode, "endpoint", rzyre_node_endpoint, 0 );
 
+	rb_define_method( rzyre_cZyreNode, "zero_copy=", rzyre_node_zero_copy_eq, 1 );
+	rb_define_method( rzyre_cZyreNode, "zero_copy?", rzyre_node_zero_copy_p, 0 );
+
+	rb_define_method( rzyre_cZyreNode, "compression_threshold=", rzyre_node_compression_threshold_eq, 1 );
+	rb_define_method( rzyre_cZyreNode, "compression_threshold", rzyre_node_compression_threshold, 0 );
+	rb_define_method( rzyre_cZyreNode, "compression_stats", rzyre_node_compression_stats, 0 );
+
 	rb_define_method( rzyre_cZyreNode, "set_header", rzyre_node_set_header, 2 );
 
 	rb_define_method( rzyre_cZyreNode, "gossip_bind", rzyre_node_gossip_bind, 1 );
@@ -823,10 +2426,21 @@ rzyre_init_node( void )
 	rb_define_method( rzyre_cZyreNode, "join", rzyre_node_join, 1 );
 	rb_define_method( rzyre_cZyreNode, "leave", rzyre_node_leave, 1 );
 
-	rb_define_method( rzyre_cZyreNode, "recv", rzyre_node_recv, 0 );
+	rb_define_method( rzyre_cZyreNode, "recv", rzyre_node_recv, -1 );
+	rb_define_method( rzyre_cZyreNode, "start_reader", rzyre_node_start_reader, -1 );
+	rb_define_method( rzyre_cZyreNode, "stop_reader", rzyre_node_stop_reader, 0 );
+	rb_define_method( rzyre_cZyreNode, "reader_stats", rzyre_node_reader_stats, 0 );
+
+	rb_define_method( rzyre_cZyreNode, "filter=", rzyre_node_filter_eq, 1 );
+	rb_define_method( rzyre_cZyreNode, "filter", rzyre_node_filter, 0 );
+	rb_define_method( rzyre_cZyreNode, "filter_stats", rzyre_node_filter_stats, 0 );
 
 	rb_define_method( rzyre_cZyreNode, "whisper", rzyre_node_whisper, -1 );
 	rb_define_method( rzyre_cZyreNode, "shout", rzyre_node_shout, -1 );
+	rb_define_method( rzyre_cZyreNode, "whisper_batch", rzyre_node_whisper_batch, 1 );
+	rb_define_method( rzyre_cZyreNode, "shout_batch", rzyre_node_shout_batch, 1 );
+	rb_define_method( rzyre_cZyreNode, "whisper_encoded", rzyre_node_whisper_encoded, 2 );
+	rb_define_method( rzyre_cZyreNode, "shout_encoded", rzyre_node_shout_encoded, 2 );
 
 	rb_define_method( rzyre_cZyreNode, "peers", rzyre_node_peers, 0 );
 	rb_define_method( rzyre_cZyreNode, "peers_by_group", rzyre_node_peers_by_group, 1 );
@@ -834,6 +2448,14 @@ rzyre_init_node( void )
 	rb_define_method( rzyre_cZyreNode, "peer_groups", rzyre_node_peer_groups, 0 );
 	rb_define_method( rzyre_cZyreNode, "peer_address", rzyre_node_peer_address, 1 );
 	rb_define_method( rzyre_cZyreNode, "peer_header_value", rzyre_node_peer_header_value, 2 );
+	rb_define_method( rzyre_cZyreNode, "peer_info", rzyre_node_peer_info, 1 );
+	rb_define_method( rzyre_cZyreNode, "peer_headers", rzyre_node_peer_headers, 1 );
+
+	rb_define_method( rzyre_cZyreNode, "local_directory=", rzyre_node_local_directory_eq, 1 );
+	rb_define_method( rzyre_cZyreNode, "local_directory?", rzyre_node_local_directory_p, 0 );
+	rb_define_method( rzyre_cZyreNode, "directory_generation", rzyre_node_directory_generation, 0 );
+	rb_define_method( rzyre_cZyreNode, "peer?", rzyre_node_peer_p, 1 );
+	rb_define_method( rzyre_cZyreNode, "peer_in_group?", rzyre_node_peer_in_group_p, 2 );
 
 	rb_define_method( rzyre_cZyreNode, "verbose!", rzyre_node_verbose_bang, 0 );
 	rb_define_method( rzyre_cZyreNode, "print", rzyre_node_print, 0 );
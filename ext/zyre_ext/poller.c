@@ -12,12 +12,16 @@
 VALUE rzyre_cZyrePoller;
 
 
+static void rzyre_poller_mark( void *ptr );
 static void rzyre_poller_free( void *ptr );
 
+// The keyword argument of #wait_all
+static ID id_order;
+
 static const rb_data_type_t rzyre_poller_t = {
 	"Zyre::Poller",
 	{
-		NULL,
+		rzyre_poller_mark,
 		rzyre_poller_free
 	},
 	0,
@@ -26,6 +30,42 @@ static const rb_data_type_t rzyre_poller_t = {
 };
 
 
+/*
+ * Mark an entry's node
+ */
+static int
+rzyre_poller_mark_entry( st_data_t socket, st_data_t entry, st_data_t arg )
+{
+	rb_gc_mark( ((rzyre_poller_entry_t *)entry)->node );
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Mark function
+ */
+static void
+rzyre_poller_mark( void *ptr )
+{
+	rzyre_poller_data_t *data = (rzyre_poller_data_t *)ptr;
+
+	if ( data->entries ) {
+		st_foreach( data->entries, rzyre_poller_mark_entry, 0 );
+	}
+}
+
+
+/*
+ * Free an entry
+ */
+static int
+rzyre_poller_free_entry( st_data_t socket, st_data_t entry, st_data_t arg )
+{
+	xfree( (rzyre_poller_entry_t *)entry );
+	return ST_CONTINUE;
+}
+
+
 /*
  * Free function
  */
@@ -33,7 +73,15 @@ static void
 rzyre_poller_free( void *ptr )
 {
 	if ( ptr ) {
-		zpoller_destroy( (zpoller_t **)&ptr );
+		rzyre_poller_data_t *data = (rzyre_poller_data_t *)ptr;
+
+		if ( data->poller ) zpoller_destroy( &data->poller );
+		if ( data->entries ) {
+			st_foreach( data->entries, rzyre_poller_free_entry, 0 );
+			st_free_table( data->entries );
+		}
+
+		xfree( data );
 	}
 }
 
@@ -44,17 +92,19 @@ rzyre_poller_free( void *ptr )
 static VALUE
 rzyre_poller_alloc( VALUE klass )
 {
-	return TypedData_Wrap_Struct( klass, &rzyre_poller_t, NULL );
+	rzyre_poller_data_t *data;
+
+	return TypedData_Make_Struct( klass, rzyre_poller_data_t, &rzyre_poller_t, data );
 }
 
 
 /*
  * Fetch the data pointer and check it for sanity.
  */
-static inline zpoller_t *
+static inline rzyre_poller_data_t *
 rzyre_get_poller( VALUE self )
 {
-	zpoller_t *ptr;
+	rzyre_poller_data_t *ptr;
 
 	if ( !IsZyrePoller(self) ) {
 		rb_raise( rb_eTypeError, "wrong argument type %s (expected Zyre::Poller)",
@@ -62,7 +112,7 @@ rzyre_get_poller( VALUE self )
 	}
 
 	ptr = DATA_PTR( self );
-	assert( ptr );
+	assert( ptr->poller );
 
 	return ptr;
 }
@@ -78,14 +128,13 @@ rzyre_get_poller( VALUE self )
 static VALUE
 rzyre_poller_initialize( VALUE self, VALUE nodes )
 {
-	zpoller_t *ptr;
-
-	TypedData_Get_Struct( self, zpoller_t, &rzyre_poller_t, ptr );
-	if ( !ptr ) {
-		RTYPEDDATA_DATA( self ) = ptr = zpoller_new( NULL );
-		assert( ptr );
+	rzyre_poller_data_t *ptr;
 
-		rb_ivar_set( self, rb_intern("@nodes"), rb_hash_new() );
+	TypedData_Get_Struct( self, rzyre_poller_data_t, &rzyre_poller_t, ptr );
+	if ( !ptr->poller ) {
+		ptr->poller = zpoller_new( NULL );
+		ptr->entries = st_init_numtable();
+		assert( ptr->poller );
 	}
 
 	rb_funcall( self, rb_intern("add"), 1, nodes );
@@ -104,40 +153,65 @@ rzyre_poller_initialize( VALUE self, VALUE nodes )
 static VALUE
 rzyre_poller_add( VALUE self, VALUE nodes )
 {
-	zpoller_t *ptr = rzyre_get_poller( self );
-	VALUE nodemap = rb_ivar_get( self, rb_intern("@nodes") );
+	rzyre_poller_data_t *ptr = rzyre_get_poller( self );
+	rzyre_poller_entry_t *entry;
 	long i;
 
-	// For each node given, record its endpoint in @nodes so we can map it back to
-	// the node later and add it to the poller.
+	// For each node given, add an entry to the node table so we can map its socket
+	// back to the node later, and add it to the poller.
 	nodes = rb_funcall( nodes, rb_intern("flatten"), 0 );
 	for ( i=0; i < RARRAY_LEN(nodes); i++ ) {
 		VALUE node = RARRAY_AREF( nodes, i );
 		zyre_t *zyre_node = rzyre_get_node( node );
 		zsock_t *sock = zyre_socket( zyre_node );
-		const char *endpoint_str = zsock_endpoint( sock );
 
-		assert( endpoint_str );
+		assert( sock );
+		rzyre_node_check_reader( node );
+		if ( st_is_member(ptr->entries, (st_data_t)sock) ) continue;
+
+		entry = ALLOC( rzyre_poller_entry_t );
+		entry->node = node;
+		entry->socket = sock;
+		entry->served = 0;
+		st_insert( ptr->entries, (st_data_t)sock, (st_data_t)entry );
 
-		rb_hash_aset( nodemap, rb_str_new2(endpoint_str), node );
-		zpoller_add( ptr, sock );
+		zpoller_add( ptr->poller, sock );
 	}
 
 	return Qtrue;
 }
 
 
+/*
+ * st_foreach callback that adds an entry's node to a Hash keyed by endpoint.
+ */
+static int
+rzyre_poller_nodemap_i( st_data_t socket, st_data_t entry, st_data_t nodemap )
+{
+	const char *endpoint_str = zsock_endpoint( (zsock_t *)socket );
+
+	assert( endpoint_str );
+	rb_hash_aset( (VALUE)nodemap, rb_str_new2(endpoint_str), ((rzyre_poller_entry_t *)entry)->node );
+
+	return ST_CONTINUE;
+}
+
+
 /*
  * call-seq:
  *    poller.nodes   -> hash
  *
- * Return a (frozen copy) of the Hash of the nodes the Poller will wait on.
+ * Return a frozen Hash of the nodes the Poller will wait on, keyed by their
+ * endpoints.
  *
  */
 static VALUE
 rzyre_poller_nodes( VALUE self )
 {
-	VALUE rval = rb_obj_dup( rb_ivar_get(self, rb_intern( "@nodes" )) );
+	rzyre_poller_data_t *ptr = rzyre_get_poller( self );
+	VALUE rval = rb_hash_new();
+
+	st_foreach( ptr->entries, rzyre_poller_nodemap_i, (st_data_t)rval );
 
 	return rb_hash_freeze( rval );
 }
@@ -147,37 +221,128 @@ rzyre_poller_nodes( VALUE self )
  * call-seq:
  *    poller.remove( *nodes )
  *
- * Add the specified +nodes+ to the list which will be polled by a call to #wait.
+ * Remove the specified +nodes+ from the list which will be polled by a call to #wait.
  *
  */
 static VALUE
 rzyre_poller_remove( VALUE self, VALUE nodes )
 {
-	zpoller_t *ptr = rzyre_get_poller( self );
-	VALUE nodemap = rb_ivar_get( self, rb_intern("@nodes") );
+	rzyre_poller_data_t *ptr = rzyre_get_poller( self );
+	st_data_t entry;
 	long i;
 
-	// For each node given, record its endpoint in @nodes so we can map it back to
-	// the node later and remove it to the poller.
 	nodes = rb_funcall( nodes, rb_intern("flatten"), 0 );
 	for ( i=0; i < RARRAY_LEN(nodes); i++ ) {
 		VALUE node = RARRAY_AREF( nodes, i );
 		zyre_t *zyre_node = rzyre_get_node( node );
 		zsock_t *sock = zyre_socket( zyre_node );
-		const char *endpoint_str = zsock_endpoint( sock );
-
-		assert( endpoint_str );
 
-		rb_hash_aset( nodemap, rb_str_new2(endpoint_str), node );
-		zpoller_remove( ptr, sock );
+		if ( st_delete(ptr->entries, (st_data_t *)&sock, &entry) ) {
+			xfree( (rzyre_poller_entry_t *)entry );
+			zpoller_remove( ptr->poller, sock );
+		}
 	}
 
 	return Qtrue;
 }
 
 
+/*
+ * st_foreach callback that collects the poller's entries in registration order.
+ */
+static int
+rzyre_poller_collect_entry( st_data_t socket, st_data_t entry, st_data_t entries_ptr )
+{
+	rzyre_poller_entry_t ***entries = (rzyre_poller_entry_t ***)entries_ptr;
+
+	**entries = (rzyre_poller_entry_t *)entry;
+	(*entries)++;
+
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Fill +entries+, +nodes+ and +items+ from the registered nodes, in registration
+ * order. Each should have room for all of the poller's entries.
+ */
+static void
+rzyre_poller_collect( rzyre_poller_data_t *ptr, rzyre_poller_entry_t **entries, VALUE *nodes,
+	zmq_pollitem_t *items )
+{
+	rzyre_poller_entry_t **cur = entries;
+	long i;
+
+	st_foreach( ptr->entries, rzyre_poller_collect_entry, (st_data_t)&cur );
+	for ( i = 0 ; i < (long)ptr->entries->num_entries ; i++ ) {
+		nodes[ i ] = entries[ i ]->node;
+		items[ i ].socket = zsock_resolve( entries[i]->socket );
+		items[ i ].fd = 0;
+		items[ i ].events = ZMQ_POLLIN;
+		items[ i ].revents = 0;
+	}
+}
+
+
+/*
+ * st_foreach callback that adds an entry's node to an Array.
+ */
+static int
+rzyre_poller_node_list_i( st_data_t socket, st_data_t entry, st_data_t nodes )
+{
+	rb_ary_push( (VALUE)nodes, ((rzyre_poller_entry_t *)entry)->node );
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Return a frozen Array of the poller's nodes, for marking them as being polled.
+ */
+static VALUE
+rzyre_poller_node_list( rzyre_poller_data_t *ptr )
+{
+	VALUE nodes = rb_ary_new_capa( ptr->entries->num_entries );
+
+	st_foreach( ptr->entries, rzyre_poller_node_list_i, (st_data_t)nodes );
+
+	return rb_ary_freeze( nodes );
+}
+
+
+/*
+ * Wait for one of the poller's nodes to have input via the current Fiber
+ * scheduler and return the first (in registration order) that does, or nil if the
+ * +timeout+ expires.
+ */
+static VALUE
+rzyre_poller_fiber_wait( rzyre_poller_data_t *ptr, int timeout )
+{
+	long count = ptr->entries->num_entries, i;
+	VALUE tmpbuf, tmpbuf2, tmpbuf3, rval = Qnil;
+	rzyre_poller_entry_t **entries = ALLOCV_N( rzyre_poller_entry_t *, tmpbuf, count );
+	VALUE *nodes = ALLOCV_N( VALUE, tmpbuf2, count );
+	zmq_pollitem_t *items = ALLOCV_N( zmq_pollitem_t, tmpbuf3, count );
+
+	rzyre_poller_collect( ptr, entries, nodes, items );
+	if ( rzyre_fiber_poll(nodes, items, (int)count, timeout) > 0 ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			if ( items[i].revents & ZMQ_POLLIN ) {
+				rval = nodes[ i ];
+				break;
+			}
+		}
+	}
+
+	ALLOCV_END( tmpbuf3 );
+	ALLOCV_END( tmpbuf2 );
+	ALLOCV_END( tmpbuf );
+
+	return rval;
+}
+
+
 typedef struct {
-	zpoller_t *poller;
+	rzyre_poller_data_t *data;
 	int timeout;
 } wait_call_t;
 
@@ -188,7 +353,33 @@ static void *
 rzyre_poller_wait_without_gvl( void *wait_call )
 {
 	wait_call_t *call = (wait_call_t *)wait_call;
-	return zpoller_wait( call->poller, call->timeout );
+	return zpoller_wait( call->data->poller, call->timeout );
+}
+
+
+/*
+ * Wait for one of the poller's nodes to have input, through the current Fiber
+ * scheduler if there is one, and return it.
+ */
+static VALUE
+rzyre_poller_wait_poll( VALUE wait_call )
+{
+	wait_call_t *call = (wait_call_t *)wait_call;
+	zsock_t *sock;
+	st_data_t entry;
+
+	if ( RZYRE_FIBER_SCHEDULER_P() ) {
+		return rzyre_poller_fiber_wait( call->data, call->timeout );
+	}
+
+	sock = (zsock_t *)rb_thread_call_without_gvl2( rzyre_poller_wait_without_gvl, (void *)call,
+		RUBY_UBF_IO, 0 );
+
+	if ( sock && st_lookup(call->data->entries, (st_data_t)sock, &entry) ) {
+		return ((rzyre_poller_entry_t *)entry)->node;
+	}
+
+	return Qnil;
 }
 
 
@@ -200,17 +391,15 @@ rzyre_poller_wait_without_gvl( void *wait_call )
  * timeout should be zero or greater, or -1 to wait indefinitely. Socket
  * priority is defined by their order in the poll list. If the timeout expired,
  * returns nil. If poll call is interrupted (SIGINT) or the ZMQ context was
- * destroyed, an Interrupt is raised.
+ * destroyed, an Interrupt is raised. If there is a Fiber scheduler active, only
+ * the current fiber waits.
  *
  */
 static VALUE
 rzyre_poller_wait( int argc, VALUE *argv, VALUE self )
 {
-	zpoller_t *ptr = rzyre_get_poller( self );
-	VALUE rval = Qnil;
-	zsock_t *sock;
+	rzyre_poller_data_t *ptr = rzyre_get_poller( self );
 	VALUE timeout_arg;
-	VALUE nodemap = rb_ivar_get( self, rb_intern("@nodes") );
 	int timeout = -1;
 	wait_call_t call;
 
@@ -219,22 +408,172 @@ rzyre_poller_wait( int argc, VALUE *argv, VALUE self )
 	}
 
 	rzyre_log_obj( self, "debug", "waiting on %d socket/s (timeout: %d)",
-		 RHASH_SIZE(nodemap), timeout );
+		 (int)ptr->entries->num_entries, timeout );
 
-	call.poller = ptr;
+	call.data = ptr;
 	call.timeout = timeout;
-	sock = (zsock_t *)rb_thread_call_without_gvl2( rzyre_poller_wait_without_gvl, (void *)&call,
-		RUBY_UBF_IO, 0 );
 
-	if ( sock ) {
-		const char *endpoint = zsock_endpoint( sock );
-		rval = rb_hash_aref( nodemap, rb_str_new2(endpoint) );
+	return rzyre_nodes_polling( rzyre_poller_node_list(ptr), rzyre_poller_wait_poll, (VALUE)&call );
+}
+
+
+
+// Struct for passing arguments to rzyre_poller_wait_all_poll() and
+// rzyre_poller_wait_all_without_gvl()
+typedef struct {
+	VALUE *nodes;
+	zmq_pollitem_t *items;
+	int count;
+	int timeout;
+	int ready;
+} wait_all_call_t;
+
+// A ready entry and its position in registration order, for sorting
+typedef struct {
+	rzyre_poller_entry_t *entry;
+	long index;
+} ready_entry_t;
+
+
+/*
+ * Async poll function for #wait_all; called without the GVL.
+ */
+static void *
+rzyre_poller_wait_all_without_gvl( void *wait_call )
+{
+	wait_all_call_t *call = (wait_all_call_t *)wait_call;
+
+	call->ready = zmq_poll( call->items, call->count, call->timeout );
+
+	return NULL;
+}
+
+
+/*
+ * Poll all of the call's nodes, through the current Fiber scheduler if there is
+ * one.
+ */
+static VALUE
+rzyre_poller_wait_all_poll( VALUE wait_call )
+{
+	wait_all_call_t *call = (wait_all_call_t *)wait_call;
+
+	if ( RZYRE_FIBER_SCHEDULER_P() ) {
+		call->ready = rzyre_fiber_poll( call->nodes, call->items, call->count, call->timeout );
+	} else {
+		rb_thread_call_without_gvl2( rzyre_poller_wait_all_without_gvl, (void *)call, RUBY_UBF_IO, 0 );
 	}
 
-	return rval;
+	return Qnil;
+}
+
+
+/*
+ * Sort function for ready entries, least-recently served first.
+ */
+static int
+rzyre_poller_cmp_least_recent( const void *a, const void *b )
+{
+	const ready_entry_t *ready_a = (const ready_entry_t *)a;
+	const ready_entry_t *ready_b = (const ready_entry_t *)b;
+
+	if ( ready_a->entry->served != ready_b->entry->served )
+		return ready_a->entry->served < ready_b->entry->served ? -1 : 1;
+
+	return ready_a->index < ready_b->index ? -1 : ( ready_a->index > ready_b->index );
 }
 
 
+/*
+ * call-seq:
+ *    poller.wait_all( timeout=-1, order: :round_robin )   -> array
+ *
+ * Poll all of the registered nodes for I/O with a single call and return every
+ * one that has input, or an empty Array if the timeout expired. The timeout is in
+ * the same units as #wait. The +order+ of the returned nodes can be one of:
+ *
+ * [:round_robin]
+ *   Start with the next ready node after the one which was first the previous
+ *   time, so each node takes a turn at the front.
+ * [:least_recent]
+ *   Order ready nodes by how long it's been since #wait_all last returned them.
+ * [:insertion]
+ *   The order in which the nodes were added, which is what #wait uses.
+ *
+ * If there is a Fiber scheduler active, only the current fiber waits.
+ *
+ */
+static VALUE
+rzyre_poller_wait_all( int argc, VALUE *argv, VALUE self )
+{
+	rzyre_poller_data_t *ptr = rzyre_get_poller( self );
+	VALUE timeout_arg, opts, order = Qnil, rval = rb_ary_new(), tmpbuf, tmpbuf2, tmpbuf3, tmpbuf4;
+	ID order_id;
+	rzyre_poller_entry_t **entries;
+	VALUE *nodes;
+	ready_entry_t *ready;
+	long count = ptr->entries->num_entries, ready_count = 0, start = 0, i;
+	wait_all_call_t call;
+
+	rb_scan_args( argc, argv, "01:", &timeout_arg, &opts );
+	if ( !NIL_P(opts) ) rb_get_kwargs( opts, &id_order, 0, 1, &order );
+
+	order_id = ( NIL_P(order) || order == Qundef ) ? rb_intern( "round_robin" ) : rb_sym2id( order );
+	if ( order_id != rb_intern("round_robin") && order_id != rb_intern("least_recent") &&
+	     order_id != rb_intern("insertion") )
+	{
+		rb_raise( rb_eArgError, "unknown order %" PRIsVALUE, rb_inspect(order) );
+	}
+
+	call.timeout = -1;
+	if ( !NIL_P(timeout_arg) ) call.timeout = floor( NUM2DBL(timeout_arg) * 1000 );
+	if ( !count ) return rval;
+
+	entries = ALLOCV_N( rzyre_poller_entry_t *, tmpbuf, count );
+	call.items = ALLOCV_N( zmq_pollitem_t, tmpbuf2, count );
+	ready = ALLOCV_N( ready_entry_t, tmpbuf3, count );
+	nodes = ALLOCV_N( VALUE, tmpbuf4, count );
+
+	rzyre_poller_collect( ptr, entries, nodes, call.items );
+	call.nodes = nodes;
+	call.count = (int)count;
+	call.ready = 0;
+
+	rzyre_log_obj( self, "debug", "waiting on all of %ld socket/s (timeout: %d)", count, call.timeout );
+	rzyre_nodes_polling( rb_ary_freeze(rb_ary_new_from_values(count, nodes)),
+		rzyre_poller_wait_all_poll, (VALUE)&call );
+
+	if ( call.ready > 0 ) {
+		if ( order_id == rb_intern("round_robin") ) start = ptr->cursor % count;
+
+		for ( i = 0 ; i < count ; i++ ) {
+			long idx = ( start + i ) % count;
+			if ( call.items[idx].revents & ZMQ_POLLIN ) {
+				ready[ ready_count ].entry = entries[ idx ];
+				ready[ ready_count ].index = idx;
+				ready_count++;
+			}
+		}
+
+		if ( order_id == rb_intern("least_recent") )
+			qsort( ready, ready_count, sizeof(ready_entry_t), rzyre_poller_cmp_least_recent );
+		if ( ready_count )
+			ptr->cursor = ready[ 0 ].index + 1;
+
+		for ( i = 0 ; i < ready_count ; i++ ) {
+			ready[ i ].entry->served = ++ptr->serial;
+			rb_ary_push( rval, ready[i].entry->node );
+		}
+	}
+
+	ALLOCV_END( tmpbuf4 );
+	ALLOCV_END( tmpbuf3 );
+	ALLOCV_END( tmpbuf2 );
+	ALLOCV_END( tmpbuf );
+
+	return rval;
+}
+
 
 /*
  * Initialize the Poller class.
@@ -260,12 +599,15 @@ rzyre_init_poller( void ) {
 
 	rb_define_alloc_func( rzyre_cZyrePoller, rzyre_poller_alloc );
 
+	id_order = rb_intern( "order" );
+
 	rb_define_protected_method( rzyre_cZyrePoller, "initialize", rzyre_poller_initialize, -2 );
 
 	rb_define_method( rzyre_cZyrePoller, "add", rzyre_poller_add, -2 );
 	rb_define_method( rzyre_cZyrePoller, "nodes", rzyre_poller_nodes, 0 );
-	rb_define_method( rzyre_cZyrePoller, "remove", rzyre_poller_remove, 1 );
+	rb_define_method( rzyre_cZyrePoller, "remove", rzyre_poller_remove, -2 );
 	rb_define_method( rzyre_cZyrePoller, "wait", rzyre_poller_wait, -1 );
+	rb_define_method( rzyre_cZyrePoller, "wait_all", rzyre_poller_wait_all, -1 );
 
 	rb_require( "zyre/poller" );
 }
@@ -0,0 +1,822 @@
+/*
+ *  reactor.c - An event loop for Zyre nodes built on zloop
+ *  $Id$
+ *
+ *  Authors:
+ *    * Michael Granger <ged@FaerieMUD.org>
+ *
+ */
+
+#include "zyre_ext.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+VALUE rzyre_cZyreReactor;
+
+
+static void rzyre_reactor_mark( void *ptr );
+static void rzyre_reactor_free( void *ptr );
+
+static ID id_call;
+
+static const rb_data_type_t rzyre_reactor_t = {
+	"Zyre::Reactor",
+	{
+		rzyre_reactor_mark,
+		rzyre_reactor_free
+	},
+	0,
+	0,
+	RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+
+/*
+ * Mark an entry's node and handlers
+ */
+static int
+rzyre_reactor_mark_entry( st_data_t socket, st_data_t entry, st_data_t arg )
+{
+	rb_gc_mark( ((rzyre_reactor_entry_t *)entry)->node );
+	rb_gc_mark( ((rzyre_reactor_entry_t *)entry)->handlers );
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Mark function
+ */
+static void
+rzyre_reactor_mark( void *ptr )
+{
+	rzyre_reactor_data_t *data = (rzyre_reactor_data_t *)ptr;
+
+	rb_gc_mark( data->timers );
+	rb_gc_mark( data->thread );
+	rb_gc_mark( data->error );
+
+	if ( data->entries ) {
+		st_foreach( data->entries, rzyre_reactor_mark_entry, 0 );
+	}
+}
+
+
+/*
+ * Free an entry
+ */
+static int
+rzyre_reactor_free_entry( st_data_t socket, st_data_t entry, st_data_t arg )
+{
+	xfree( (rzyre_reactor_entry_t *)entry );
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Free function
+ */
+static void
+rzyre_reactor_free( void *ptr )
+{
+	if ( ptr ) {
+		rzyre_reactor_data_t *data = (rzyre_reactor_data_t *)ptr;
+
+		if ( data->loop ) {
+			zloop_destroy( &data->loop );
+			close( data->wakeup[0] );
+			close( data->wakeup[1] );
+		}
+		if ( data->entries ) {
+			st_foreach( data->entries, rzyre_reactor_free_entry, 0 );
+			st_free_table( data->entries );
+		}
+
+		xfree( data );
+	}
+}
+
+
+/*
+ * Alloc function
+ */
+static VALUE
+rzyre_reactor_alloc( VALUE klass )
+{
+	rzyre_reactor_data_t *data;
+	VALUE rval = TypedData_Make_Struct( klass, rzyre_reactor_data_t, &rzyre_reactor_t, data );
+
+	data->timers = Qnil;
+	data->thread = Qnil;
+	data->error = Qnil;
+
+	return rval;
+}
+
+
+/*
+ * Fetch the data pointer and check it for sanity.
+ */
+static inline rzyre_reactor_data_t *
+rzyre_get_reactor( VALUE self )
+{
+	rzyre_reactor_data_t *ptr;
+
+	if ( !IsZyreReactor(self) ) {
+		rb_raise( rb_eTypeError, "wrong argument type %s (expected Zyre::Reactor)",
+			rb_class2name(CLASS_OF( self )) );
+	}
+
+	ptr = DATA_PTR( self );
+	assert( ptr->loop );
+
+	return ptr;
+}
+
+
+/*
+ * Raise if the reactor is running in a thread other than the current one; zloop
+ * can only be changed from the thread running it.
+ */
+static void
+rzyre_reactor_check_thread( rzyre_reactor_data_t *ptr )
+{
+	if ( !NIL_P(ptr->thread) && ptr->thread != rb_thread_current() )
+		rb_raise( rb_eRuntimeError, "a running reactor can only be changed from its handlers" );
+}
+
+
+/*
+ * Wake the reactor's loop so it returns from zloop_start(); used as the unblocking
+ * function for the loop, and by #stop from other threads. Only uses write(2), so
+ * it's safe to call from any thread.
+ */
+static void
+rzyre_reactor_wakeup( void *reactor )
+{
+	rzyre_reactor_data_t *ptr = (rzyre_reactor_data_t *)reactor;
+	const char byte = 0;
+
+	if ( write(ptr->wakeup[1], &byte, 1) < 0 ) {
+		// The pipe is full, so the loop is already being woken
+	}
+}
+
+
+/*
+ * Poller handler for the wakeup pipe; drains it and ends the loop.
+ */
+static int
+rzyre_reactor_woken( zloop_t *loop, zmq_pollitem_t *item, void *reactor )
+{
+	char buf[ 64 ];
+
+	while ( read(item->fd, buf, sizeof buf) > 0 ) ;
+
+	return -1;
+}
+
+
+/*
+ * call-seq:
+ *    Zyre::Reactor.new   -> reactor
+ *
+ * Create a new reactor with no nodes or timers.
+ *
+ */
+static VALUE
+rzyre_reactor_initialize( VALUE self )
+{
+	rzyre_reactor_data_t *ptr;
+
+	TypedData_Get_Struct( self, rzyre_reactor_data_t, &rzyre_reactor_t, ptr );
+	if ( !ptr->loop ) {
+		if ( pipe(ptr->wakeup) < 0 ) rb_sys_fail( "pipe" );
+		fcntl( ptr->wakeup[0], F_SETFL, O_NONBLOCK );
+		fcntl( ptr->wakeup[1], F_SETFL, O_NONBLOCK );
+
+		ptr->loop = zloop_new();
+		ptr->entries = st_init_numtable();
+		ptr->timers = rb_hash_new();
+		assert( ptr->loop );
+
+		ptr->wakeup_item.socket = NULL;
+		ptr->wakeup_item.fd = ptr->wakeup[0];
+		ptr->wakeup_item.events = ZMQ_POLLIN;
+		zloop_poller( ptr->loop, &ptr->wakeup_item, rzyre_reactor_woken, ptr );
+	}
+
+	return self;
+}
+
+
+/*
+ * Count the given reactor +entry+'s node as being polled while the reactor runs,
+ * which keeps a background reader from being started on it.
+ */
+static void
+rzyre_reactor_begin_polling( rzyre_reactor_entry_t *entry )
+{
+	if ( entry->polling ) return;
+
+	entry->node_data->polled++;
+	entry->polling = TRUE;
+}
+
+
+/*
+ * Stop counting the given reactor +entry+'s node as being polled.
+ */
+static void
+rzyre_reactor_end_polling( rzyre_reactor_entry_t *entry )
+{
+	if ( !entry->polling ) return;
+
+	entry->node_data->polled--;
+	entry->polling = FALSE;
+}
+
+
+/*
+ * Save the exception raised by a handler so #run can re-raise it once the loop has
+ * stopped.
+ */
+static void
+rzyre_reactor_save_error( rzyre_reactor_data_t *ptr )
+{
+	VALUE error = rb_errinfo();
+
+	rb_set_errinfo( Qnil );
+
+	// Non-local exits like `throw` can't be carried out of the loop
+	if ( !RB_TYPE_P(error, T_OBJECT) || !rb_obj_is_kind_of(error, rb_eException) )
+		error = rb_exc_new_cstr( rb_eLocalJumpError, "non-local exit from a reactor handler" );
+
+	if ( NIL_P(ptr->error) ) ptr->error = error;
+}
+
+
+// Struct for passing a handler call through rb_thread_call_with_gvl()
+typedef struct {
+	rzyre_reactor_data_t *reactor;
+	VALUE (*func)( VALUE );
+	VALUE arg;
+} reactor_handler_call_t;
+
+
+/*
+ * Call the handler function of the call with rb_protect; called with the GVL.
+ */
+static void *
+rzyre_reactor_call_handler_with_gvl( void *handler_call )
+{
+	reactor_handler_call_t *call = (reactor_handler_call_t *)handler_call;
+	int state;
+
+	rb_protect( call->func, call->arg, &state );
+	if ( state ) rzyre_reactor_save_error( call->reactor );
+
+	return NULL;
+}
+
+
+/*
+ * Reacquire the GVL and call +func+ with +arg+, then return what the loop handler
+ * calling it should return to zloop: -1 if the loop should stop, 0 otherwise.
+ */
+static int
+rzyre_reactor_call_handler( rzyre_reactor_data_t *ptr, VALUE (*func)(VALUE), VALUE arg )
+{
+	reactor_handler_call_t call = { ptr, func, arg };
+
+	rb_thread_call_with_gvl( rzyre_reactor_call_handler_with_gvl, (void *)&call );
+
+	return ( ptr->stopping || !NIL_P(ptr->error) ) ? -1 : 0;
+}
+
+
+// Struct for passing an event through rzyre_reactor_dispatch()
+typedef struct {
+	rzyre_reactor_entry_t *entry;
+	zyre_event_t *event;
+	unsigned int bit;
+} reactor_dispatch_call_t;
+
+
+/*
+ * Let the node see the call's event, then wrap it and pass it to each of the
+ * entry's handlers for its type. Handlers can unregister the node, so the entry
+ * isn't touched once the first one has been called.
+ */
+static VALUE
+rzyre_reactor_dispatch( VALUE dispatch_call )
+{
+	reactor_dispatch_call_t *call = (reactor_dispatch_call_t *)dispatch_call;
+	rzyre_reactor_entry_t *entry = call->entry;
+	const VALUE node = entry->node, handlers = entry->handlers;
+	const long count = RARRAY_LEN( handlers );
+	const unsigned int bit = call->bit;
+	VALUE event, pair;
+	long i;
+
+	rzyre_compression_stats_add( &entry->node_data->decompressed, &entry->stats );
+	memset( &entry->stats, 0, sizeof entry->stats );
+
+	rzyre_node_observe_event( node, call->event );
+	if ( !(entry->mask & bit) ) return Qnil;
+
+	event = rzyre_wrap_event( rzyre_cZyreEvent, call->event );
+	call->event = NULL;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		pair = RARRAY_AREF( handlers, i );
+		if ( NUM2UINT(RARRAY_AREF(pair, 0)) & bit )
+			rb_funcall( RARRAY_AREF(pair, 1), id_call, 1, event );
+	}
+
+	return Qnil;
+}
+
+
+/*
+ * Reader handler for registered nodes; called by zloop without the GVL. Reads and
+ * decodes the waiting event, and only takes the GVL if it passes the node's filter
+ * and there's a handler for it (or the node's local directory needs to see it).
+ */
+static int
+rzyre_reactor_node_readable( zloop_t *loop, zsock_t *socket, void *reactor_entry )
+{
+	rzyre_reactor_entry_t *entry = (rzyre_reactor_entry_t *)reactor_entry;
+	rzyre_reactor_data_t *ptr = entry->reactor;
+	rzyre_node_data_t *node = entry->node_data;
+	reactor_dispatch_call_t call = { entry, NULL, 0 };
+	unsigned int bit;
+	int rval, filtered;
+	zmsg_t *msg;
+
+	if ( !(call.event = zyre_event_new(node->node)) ) return 0;
+	bit = rzyre_event_type_bit( zyre_event_type(call.event) );
+
+	filtered = rzyre_filter_event( node, call.event );
+	if ( filtered == RZYRE_FILTER_PASS && !(entry->mask & bit) ) {
+		filtered = rzyre_filter_observes( node, bit ) ? RZYRE_FILTER_OBSERVE : RZYRE_FILTER_DROP;
+	}
+
+	if ( filtered == RZYRE_FILTER_DROP ) {
+		zyre_event_destroy( &call.event );
+		return 0;
+	}
+
+	// Events that are only for the directory aren't passed to any handlers
+	if ( filtered == RZYRE_FILTER_PASS ) {
+		call.bit = bit;
+		if ( node->compression && (msg = zyre_event_msg(call.event)) )
+			rzyre_decompress_msg( msg, &entry->stats );
+	}
+
+	rval = rzyre_reactor_call_handler( ptr, rzyre_reactor_dispatch, (VALUE)&call );
+	if ( call.event ) zyre_event_destroy( &call.event );
+
+	return rval;
+}
+
+
+// Struct for passing a timer through rzyre_reactor_fire_timer()
+typedef struct {
+	rzyre_reactor_data_t *reactor;
+	int timer_id;
+} reactor_timer_call_t;
+
+
+/*
+ * Call the handler of the call's timer, forgetting the timer if this is the last
+ * time it will fire.
+ */
+static VALUE
+rzyre_reactor_fire_timer( VALUE timer_call )
+{
+	reactor_timer_call_t *call = (reactor_timer_call_t *)timer_call;
+	rzyre_reactor_data_t *ptr = call->reactor;
+	const VALUE timer_id = INT2FIX( call->timer_id );
+	VALUE timer = rb_hash_lookup( ptr->timers, timer_id );
+	long remaining;
+
+	// Cancelled
+	if ( NIL_P(timer) ) return Qnil;
+
+	remaining = NUM2LONG( RARRAY_AREF(timer, 1) );
+	if ( remaining == 1 ) {
+		rb_hash_delete( ptr->timers, timer_id );
+	} else if ( remaining > 1 ) {
+		rb_ary_store( timer, 1, LONG2NUM(remaining - 1) );
+	}
+
+	rb_funcall( RARRAY_AREF(timer, 0), id_call, 1, timer_id );
+
+	return Qnil;
+}
+
+
+/*
+ * Timer handler; called by zloop without the GVL.
+ */
+static int
+rzyre_reactor_timer_fired( zloop_t *loop, int timer_id, void *reactor )
+{
+	rzyre_reactor_data_t *ptr = (rzyre_reactor_data_t *)reactor;
+	reactor_timer_call_t call = { ptr, timer_id };
+
+	return rzyre_reactor_call_handler( ptr, rzyre_reactor_fire_timer, (VALUE)&call );
+}
+
+
+/*
+ * call-seq:
+ *    reactor.register( node, *event_types ) {|event| ... }   -> reactor
+ *
+ * Call the block with each event of one of the given +event_types+ (e.g., :WHISPER,
+ * :ENTER, or Zyre::Event::Shout) that arrives at +node+ while the reactor is
+ * running. If no +event_types+ are given, the block is called for every event.
+ * Events that no handler is registered for are read and discarded without
+ * taking the GVL. A node can be registered several times with different handlers.
+ *
+ */
+static VALUE
+rzyre_reactor_register( int argc, VALUE *argv, VALUE self )
+{
+	rzyre_reactor_data_t *ptr = rzyre_get_reactor( self );
+	rzyre_reactor_entry_t *entry;
+	rzyre_node_data_t *node_data;
+	VALUE node, types, handler;
+	unsigned int mask = 0;
+	zsock_t *socket;
+
+	rb_scan_args( argc, argv, "1*&", &node, &types, &handler );
+
+	if ( NIL_P(handler) )
+		rb_raise( rb_eArgError, "no handler block given" );
+
+	node_data = rzyre_get_node_data( node );
+	rzyre_node_check_reader( node );
+	if ( RARRAY_LEN(types) ) {
+		for ( long i = 0 ; i < RARRAY_LEN(types) ; i++ )
+			mask |= rzyre_event_type_bit_from_value( RARRAY_AREF(types, i) );
+	} else {
+		mask = RZYRE_EVENT_TYPE_ALL;
+	}
+
+	rzyre_reactor_check_thread( ptr );
+
+	socket = zyre_socket( node_data->node );
+	if ( !st_lookup(ptr->entries, (st_data_t)socket, (st_data_t *)&entry) ) {
+		entry = ALLOC( rzyre_reactor_entry_t );
+		entry->reactor = ptr;
+		entry->node = node;
+		entry->node_data = node_data;
+		entry->socket = socket;
+		entry->handlers = rb_ary_new();
+		entry->mask = 0;
+		entry->polling = FALSE;
+		memset( &entry->stats, 0, sizeof entry->stats );
+
+		if ( zloop_reader(ptr->loop, socket, rzyre_reactor_node_readable, entry) != 0 ) {
+			xfree( entry );
+			rb_raise( rb_eRuntimeError, "couldn't add %"PRIsVALUE" to the reactor", node );
+		}
+
+		st_insert( ptr->entries, (st_data_t)socket, (st_data_t)entry );
+
+		// Registered by a handler while the reactor is running
+		if ( !NIL_P(ptr->thread) ) rzyre_reactor_begin_polling( entry );
+	}
+
+	entry->mask |= mask;
+	rb_ary_push( entry->handlers, rb_ary_new_from_args(2, UINT2NUM(mask), handler) );
+
+	return self;
+}
+
+
+/*
+ * call-seq:
+ *    reactor.unregister( node )   -> true or false
+ *
+ * Remove the given +node+ and all of its handlers from the reactor. Returns
+ * +false+ if it wasn't registered.
+ *
+ */
+static VALUE
+rzyre_reactor_unregister( VALUE self, VALUE node )
+{
+	rzyre_reactor_data_t *ptr = rzyre_get_reactor( self );
+	st_data_t socket = (st_data_t)zyre_socket( rzyre_get_node(node) );
+	rzyre_reactor_entry_t *entry;
+
+	rzyre_reactor_check_thread( ptr );
+
+	if ( !st_delete(ptr->entries, &socket, (st_data_t *)&entry) ) return Qfalse;
+
+	zloop_reader_end( ptr->loop, entry->socket );
+	rzyre_compression_stats_add( &entry->node_data->decompressed, &entry->stats );
+	rzyre_reactor_end_polling( entry );
+	xfree( entry );
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    reactor.registered?( node )   -> true or false
+ *
+ * Returns +true+ if the given +node+ is registered with the reactor.
+ *
+ */
+static VALUE
+rzyre_reactor_registered_p( VALUE self, VALUE node )
+{
+	rzyre_reactor_data_t *ptr = rzyre_get_reactor( self );
+	st_data_t socket = (st_data_t)zyre_socket( rzyre_get_node(node) );
+
+	return st_lookup( ptr->entries, socket, NULL ) ? Qtrue : Qfalse;
+}
+
+
+/*
+ * call-seq:
+ *    reactor.add_timer( delay, times=1 ) {|timer_id| ... }   -> timer_id
+ *
+ * Call the block after +delay+ floating-point seconds, and then every +delay+
+ * seconds after that until it has been called +times+ times. A +times+ of 0
+ * means repeat until the timer is cancelled. Returns the ID of the timer, which
+ * is also passed to the block. See also #after and #every.
+ *
+ */
+static VALUE
+rzyre_reactor_add_timer( int argc, VALUE *argv, VALUE self )
+{
+	rzyre_reactor_data_t *ptr = rzyre_get_reactor( self );
+	VALUE delay_arg, times_arg, handler;
+	double delay;
+	long times = 1;
+	int timer_id;
+
+	rb_scan_args( argc, argv, "11&", &delay_arg, &times_arg, &handler );
+
+	if ( NIL_P(handler) )
+		rb_raise( rb_eArgError, "no handler block given" );
+
+	delay = NUM2DBL( delay_arg );
+	if ( !NIL_P(times_arg) ) times = NUM2LONG( times_arg );
+	if ( delay < 0 || times < 0 )
+		rb_raise( rb_eArgError, "delay and times can't be negative" );
+
+	rzyre_reactor_check_thread( ptr );
+
+	timer_id = zloop_timer( ptr->loop, (size_t)floor(delay * 1000), (size_t)times,
+		rzyre_reactor_timer_fired, ptr );
+	if ( timer_id < 0 )
+		rb_raise( rb_eRuntimeError, "couldn't add a timer to the reactor" );
+
+	rb_hash_aset( ptr->timers, INT2FIX(timer_id), rb_ary_new_from_args(2, handler, LONG2NUM(times)) );
+
+	return INT2FIX( timer_id );
+}
+
+
+/*
+ * call-seq:
+ *    reactor.cancel_timer( timer_id )   -> true or false
+ *
+ * Cancel the timer with the given +timer_id+. Returns +false+ if there was no
+ * such timer, or it had already fired for the last time.
+ *
+ */
+static VALUE
+rzyre_reactor_cancel_timer( VALUE self, VALUE timer_id )
+{
+	rzyre_reactor_data_t *ptr = rzyre_get_reactor( self );
+
+	rzyre_reactor_check_thread( ptr );
+
+	if ( NIL_P(rb_hash_delete(ptr->timers, timer_id)) ) return Qfalse;
+	zloop_timer_end( ptr->loop, NUM2INT(timer_id) );
+
+	return Qtrue;
+}
+
+
+/*
+ * Run the loop; called without the GVL.
+ */
+static void *
+rzyre_reactor_run_without_gvl( void *reactor )
+{
+	rzyre_reactor_data_t *ptr = (rzyre_reactor_data_t *)reactor;
+
+	ptr->result = zloop_start( ptr->loop );
+
+	return NULL;
+}
+
+
+/*
+ * Run the loop until it's stopped, a handler raises, or czmq is interrupted.
+ * Interrupts (signals, Thread#raise, etc.) wake the loop so they can be handled,
+ * after which it carries on.
+ */
+static VALUE
+rzyre_reactor_run_loop( VALUE reactor )
+{
+	rzyre_reactor_data_t *ptr = (rzyre_reactor_data_t *)reactor;
+
+	while ( !ptr->stopping && NIL_P(ptr->error) ) {
+		rb_thread_call_without_gvl( rzyre_reactor_run_without_gvl, (void *)ptr,
+			rzyre_reactor_wakeup, (void *)ptr );
+		if ( ptr->result == 0 ) break;
+	}
+
+	return Qnil;
+}
+
+
+/*
+ * st_foreach callback that raises if an entry's node has a background reader
+ * running.
+ */
+static int
+rzyre_reactor_check_reader_i( st_data_t socket, st_data_t entry, st_data_t unused )
+{
+	rzyre_node_check_reader( ((rzyre_reactor_entry_t *)entry)->node );
+	return ST_CONTINUE;
+}
+
+
+/*
+ * st_foreach callback that counts an entry's node as being polled.
+ */
+static int
+rzyre_reactor_begin_polling_i( st_data_t socket, st_data_t entry, st_data_t unused )
+{
+	rzyre_reactor_begin_polling( (rzyre_reactor_entry_t *)entry );
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Count the frames an entry has decompressed against its node, and stop counting
+ * it as being polled.
+ */
+static int
+rzyre_reactor_finish_entry( st_data_t socket, st_data_t reactor_entry, st_data_t arg )
+{
+	rzyre_reactor_entry_t *entry = (rzyre_reactor_entry_t *)reactor_entry;
+
+	rzyre_compression_stats_add( &entry->node_data->decompressed, &entry->stats );
+	memset( &entry->stats, 0, sizeof entry->stats );
+	rzyre_reactor_end_polling( entry );
+
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Clean up after the loop stops.
+ */
+static VALUE
+rzyre_reactor_run_ensure( VALUE reactor )
+{
+	rzyre_reactor_data_t *ptr = (rzyre_reactor_data_t *)reactor;
+
+	st_foreach( ptr->entries, rzyre_reactor_finish_entry, 0 );
+	ptr->thread = Qnil;
+
+	return Qnil;
+}
+
+
+/*
+ * call-seq:
+ *    reactor.run   -> reactor
+ *
+ * Run the reactor in the current thread until it's stopped with #stop. Polling
+ * the nodes, reading and decoding their events, and keeping track of timers all
+ * happen without the GVL, which is only taken to call a handler. If a handler
+ * raises an exception, the reactor stops and the exception is re-raised from
+ * #run.
+ *
+ */
+static VALUE
+rzyre_reactor_run( VALUE self )
+{
+	rzyre_reactor_data_t *ptr = rzyre_get_reactor( self );
+	VALUE error;
+
+	if ( !NIL_P(ptr->thread) )
+		rb_raise( rb_eRuntimeError, "the reactor is already running" );
+
+	// Readers started since their nodes were registered
+	st_foreach( ptr->entries, rzyre_reactor_check_reader_i, 0 );
+
+	ptr->thread = rb_thread_current();
+	ptr->stopping = FALSE;
+	ptr->error = Qnil;
+
+	rzyre_log_obj( self, "debug", "Running with %d nodes.", (int)ptr->entries->num_entries );
+	st_foreach( ptr->entries, rzyre_reactor_begin_polling_i, 0 );
+	rb_ensure( rzyre_reactor_run_loop, (VALUE)ptr, rzyre_reactor_run_ensure, (VALUE)ptr );
+
+	if ( !NIL_P(ptr->error) ) {
+		error = ptr->error;
+		ptr->error = Qnil;
+		rb_exc_raise( error );
+	}
+
+	return self;
+}
+
+
+/*
+ * call-seq:
+ *    reactor.stop   -> true or false
+ *
+ * Stop the reactor once the current handler (if any) returns. Can be called from
+ * a handler or from another thread. Returns +false+ if the reactor isn't running.
+ *
+ */
+static VALUE
+rzyre_reactor_stop( VALUE self )
+{
+	rzyre_reactor_data_t *ptr = rzyre_get_reactor( self );
+
+	if ( NIL_P(ptr->thread) ) return Qfalse;
+
+	ptr->stopping = TRUE;
+	if ( ptr->thread != rb_thread_current() ) rzyre_reactor_wakeup( ptr );
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    reactor.running?   -> true or false
+ *
+ * Returns +true+ if the reactor is running.
+ *
+ */
+static VALUE
+rzyre_reactor_running_p( VALUE self )
+{
+	rzyre_reactor_data_t *ptr = rzyre_get_reactor( self );
+
+	return NIL_P( ptr->thread ) ? Qfalse : Qtrue;
+}
+
+
+/*
+ * Initialize the Reactor class.
+ */
+void
+rzyre_init_reactor( void ) {
+
+#ifdef FOR_RDOC
+	rb_cData = rb_define_class( "Data" );
+	rzyre_mZyre = rb_define_module( "Zyre" );
+#endif
+
+	/*
+	 * Document-class: Zyre::Reactor
+	 *
+	 * An event loop for Zyre nodes, with handlers for the types of events they
+	 * receive and timers. Built on zloop from czmq.
+	 *
+	 *    reactor = Zyre::Reactor.new
+	 *    reactor.register( node, :WHISPER, :SHOUT ) {|event| handle(event) }
+	 *    reactor.every( 5 ) { node.shout('status', current_status) }
+	 *    reactor.run
+	 *
+	 * Refs:
+	 * - http://api.zeromq.org/czmq4-0:zloop
+	 *
+	 */
+	rzyre_cZyreReactor = rb_define_class_under( rzyre_mZyre, "Reactor", rb_cObject );
+
+	rb_define_alloc_func( rzyre_cZyreReactor, rzyre_reactor_alloc );
+
+	id_call = rb_intern( "call" );
+
+	rb_define_protected_method( rzyre_cZyreReactor, "initialize", rzyre_reactor_initialize, 0 );
+
+	rb_define_method( rzyre_cZyreReactor, "register", rzyre_reactor_register, -1 );
+	rb_define_method( rzyre_cZyreReactor, "unregister", rzyre_reactor_unregister, 1 );
+	rb_define_method( rzyre_cZyreReactor, "registered?", rzyre_reactor_registered_p, 1 );
+	rb_define_method( rzyre_cZyreReactor, "add_timer", rzyre_reactor_add_timer, -1 );
+	rb_define_method( rzyre_cZyreReactor, "cancel_timer", rzyre_reactor_cancel_timer, 1 );
+	rb_define_method( rzyre_cZyreReactor, "run", rzyre_reactor_run, 0 );
+	rb_define_method( rzyre_cZyreReactor, "stop", rzyre_reactor_stop, 0 );
+	rb_define_method( rzyre_cZyreReactor, "running?", rzyre_reactor_running_p, 0 );
+
+	rb_require( "zyre/reactor" );
+}
+
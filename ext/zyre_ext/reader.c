@@ -0,0 +1,369 @@
+/*
+ *  reader.c - Background reading of a node's events into a ring buffer
+ *  $Id$
+ *
+ *  Authors:
+ *    * Michael Granger <ged@FaerieMUD.org>
+ *
+ */
+
+#include "zyre_ext.h"
+
+#include <stdatomic.h>
+
+
+// A slot in a reader's ring
+typedef struct {
+	zyre_event_t *event;    //  The event
+	int observe_only;       //  Set if the event was filtered out, but the node's
+	                        //  local directory needs to see it
+} rzyre_reader_slot_t;
+
+// The state of a node's background reader. The ring is single-producer,
+// single-consumer: only the reader actor pushes onto it, and events are only
+// popped from it by Ruby threads holding the GVL. The mutex and condition variable
+// are only used when threads have to wait for the ring to fill. The reader is
+// freed when the last reference to it is released: the node holds one until the
+// reader is stopped and drained, and each thread waiting on it holds another.
+struct rzyre_reader {
+	rzyre_node_data_t *node;        //  The node being read
+	zactor_t *actor;                //  The actor reading events from the node
+	rzyre_reader_slot_t *slots;     //  The ring of events waiting to be popped
+	size_t capacity;                //  The number of slots in the ring
+	_Atomic size_t head;            //  Count of events popped; the consumer's index
+	_Atomic size_t tail;            //  Count of events pushed; the producer's index
+	_Atomic size_t high_water;      //  The deepest the ring has been
+	_Atomic unsigned long overflows;  //  Events dropped because the ring was full
+	_Atomic int waiting;            //  The number of threads waiting for events
+	_Atomic int running;            //  Set while the actor is reading events
+	_Atomic int refs;               //  The number of references to the reader
+	rzyre_compression_stats_t stats;  //  Frames the actor has decompressed
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+
+/*
+ * Add an +event+ to the ring, taking ownership of it. If the ring is full, the
+ * event is dropped and counted instead.
+ */
+static void
+rzyre_reader_push( rzyre_reader_t *reader, zyre_event_t *event, int observe_only )
+{
+	const size_t tail = atomic_load_explicit( &reader->tail, memory_order_relaxed );
+	const size_t depth = tail - atomic_load_explicit( &reader->head, memory_order_acquire );
+
+	if ( depth >= reader->capacity ) {
+		atomic_fetch_add_explicit( &reader->overflows, 1, memory_order_relaxed );
+		zyre_event_destroy( &event );
+		return;
+	}
+
+	reader->slots[ tail % reader->capacity ].event = event;
+	reader->slots[ tail % reader->capacity ].observe_only = observe_only;
+	atomic_store( &reader->tail, tail + 1 );
+
+	if ( depth + 1 > atomic_load_explicit(&reader->high_water, memory_order_relaxed) )
+		atomic_store_explicit( &reader->high_water, depth + 1, memory_order_relaxed );
+
+	// Only take the lock if there's a thread to wake
+	if ( atomic_load(&reader->waiting) ) {
+		pthread_mutex_lock( &reader->mutex );
+		pthread_cond_broadcast( &reader->cond );
+		pthread_mutex_unlock( &reader->mutex );
+	}
+}
+
+
+/*
+ * The reader actor; reads events from the node as soon as they arrive and pushes
+ * the ones that pass the node's filter onto the ring until it's told to terminate.
+ */
+static void
+rzyre_reader_actor( zsock_t *pipe, void *args )
+{
+	rzyre_reader_t *reader = (rzyre_reader_t *)args;
+	zyre_t *node = reader->node->node;
+	zpoller_t *poller = zpoller_new( pipe, zyre_socket(node), NULL );
+	rzyre_compression_stats_t stats;
+	zyre_event_t *event;
+	zmsg_t *msg;
+	char *command;
+	void *which;
+	int filtered;
+
+	zsock_signal( pipe, 0 );
+
+	while ( (which = zpoller_wait(poller, -1)) ) {
+		if ( which == pipe ) {
+			command = zstr_recv( pipe );
+			zstr_free( &command );
+			break;
+		}
+
+		if ( !(event = zyre_event_new(node)) ) break;
+
+		filtered = rzyre_filter_event( reader->node, event );
+		if ( filtered == RZYRE_FILTER_DROP ) {
+			zyre_event_destroy( &event );
+			continue;
+		}
+
+		if ( filtered == RZYRE_FILTER_PASS && reader->node->compression &&
+			(msg = zyre_event_msg(event)) )
+		{
+			memset( &stats, 0, sizeof stats );
+			rzyre_decompress_msg( msg, &stats );
+
+			if ( stats.frames ) {
+				pthread_mutex_lock( &reader->mutex );
+				rzyre_compression_stats_add( &reader->stats, &stats );
+				pthread_mutex_unlock( &reader->mutex );
+			}
+		}
+
+		rzyre_reader_push( reader, event, filtered == RZYRE_FILTER_OBSERVE );
+	}
+
+	zpoller_destroy( &poller );
+
+	pthread_mutex_lock( &reader->mutex );
+	atomic_store( &reader->running, FALSE );
+	pthread_cond_broadcast( &reader->cond );
+	pthread_mutex_unlock( &reader->mutex );
+}
+
+
+/*
+ * Create a reader for the given +node+ with room for +capacity+ events, and start
+ * its actor.
+ */
+rzyre_reader_t *
+rzyre_reader_new( rzyre_node_data_t *node, size_t capacity )
+{
+	rzyre_reader_t *reader = (rzyre_reader_t *) zmalloc( sizeof *reader );
+
+	reader->node = node;
+	reader->slots = (rzyre_reader_slot_t *) zmalloc( capacity * sizeof *reader->slots );
+	reader->capacity = capacity;
+	atomic_init( &reader->head, 0 );
+	atomic_init( &reader->tail, 0 );
+	atomic_init( &reader->high_water, 0 );
+	atomic_init( &reader->overflows, 0 );
+	atomic_init( &reader->waiting, 0 );
+	atomic_init( &reader->running, TRUE );
+	atomic_init( &reader->refs, 1 );
+	pthread_mutex_init( &reader->mutex, NULL );
+	pthread_cond_init( &reader->cond, NULL );
+
+	reader->actor = zactor_new( rzyre_reader_actor, reader );
+
+	return reader;
+}
+
+
+/*
+ * Stop the reader's actor. Events already in the ring can still be popped.
+ */
+void
+rzyre_reader_stop( rzyre_reader_t *reader )
+{
+	if ( reader->actor ) zactor_destroy( &reader->actor );
+}
+
+
+/*
+ * Add a reference to the given +reader+, which keeps it from being freed until
+ * it's released with rzyre_reader_release(). Must be called with the GVL held.
+ */
+rzyre_reader_t *
+rzyre_reader_ref( rzyre_reader_t *reader )
+{
+	atomic_fetch_add( &reader->refs, 1 );
+	return reader;
+}
+
+
+/*
+ * Release a reference to the reader pointed to by +reader_ptr+. If it was the last
+ * one, stop the reader, destroy any events left in its ring, and free it. Must be
+ * called with the GVL held.
+ */
+void
+rzyre_reader_release( rzyre_reader_t **reader_ptr )
+{
+	rzyre_reader_t *reader = *reader_ptr;
+	zyre_event_t *event;
+
+	if ( !reader ) return;
+	*reader_ptr = NULL;
+
+	if ( atomic_fetch_sub(&reader->refs, 1) > 1 ) return;
+
+	rzyre_reader_stop( reader );
+	while ( (event = rzyre_reader_pop(reader, NULL)) ) zyre_event_destroy( &event );
+
+	pthread_mutex_destroy( &reader->mutex );
+	pthread_cond_destroy( &reader->cond );
+	free( reader->slots );
+	free( reader );
+}
+
+
+/*
+ * Stop the reader pointed to by +reader_ptr+ and release the node's reference to
+ * it; it's freed once no thread is waiting on it any more.
+ */
+void
+rzyre_reader_destroy( rzyre_reader_t **reader_ptr )
+{
+	if ( !*reader_ptr ) return;
+
+	rzyre_reader_stop( *reader_ptr );
+	rzyre_reader_release( reader_ptr );
+}
+
+
+/*
+ * Pop the oldest event off the ring, or return NULL if it's empty. If +observe_only+
+ * isn't NULL, it's set if the event didn't pass the node's filter and was only kept
+ * for its local directory. Must be called with the GVL held, which is what keeps
+ * there to a single consumer.
+ */
+zyre_event_t *
+rzyre_reader_pop( rzyre_reader_t *reader, int *observe_only )
+{
+	const size_t head = atomic_load_explicit( &reader->head, memory_order_relaxed );
+	rzyre_reader_slot_t *slot;
+	zyre_event_t *event;
+
+	if ( head == atomic_load_explicit(&reader->tail, memory_order_acquire) ) return NULL;
+
+	slot = &reader->slots[ head % reader->capacity ];
+	event = slot->event;
+	if ( observe_only ) *observe_only = slot->observe_only;
+	atomic_store_explicit( &reader->head, head + 1, memory_order_release );
+
+	return event;
+}
+
+
+/*
+ * Returns true if the reader's actor is running or there are events left in its
+ * ring.
+ */
+int
+rzyre_reader_active( rzyre_reader_t *reader )
+{
+	return atomic_load( &reader->running ) ||
+		atomic_load( &reader->tail ) != atomic_load( &reader->head );
+}
+
+
+// Struct for passing arguments to rzyre_reader_wait_without_gvl()
+typedef struct {
+	rzyre_reader_t *reader;
+	int timeout;
+	int interrupted;        //  Set by the unblocking function to end this wait
+} reader_wait_call_t;
+
+
+/*
+ * Wait up to the call's timeout for an event to be pushed onto the ring; called
+ * without the GVL.
+ */
+static void *
+rzyre_reader_wait_without_gvl( void *wait_call )
+{
+	reader_wait_call_t *call = (reader_wait_call_t *)wait_call;
+	rzyre_reader_t *reader = call->reader;
+	struct timespec deadline;
+	int64_t deadline_ms = zclock_time() + call->timeout;
+
+	deadline.tv_sec = deadline_ms / 1000;
+	deadline.tv_nsec = ( deadline_ms % 1000 ) * 1000000;
+
+	// Several threads can wait on the same reader, so each one is counted
+	pthread_mutex_lock( &reader->mutex );
+	atomic_fetch_add( &reader->waiting, 1 );
+
+	while ( atomic_load(&reader->tail) == atomic_load(&reader->head) &&
+		atomic_load(&reader->running) && !call->interrupted )
+	{
+		if ( call->timeout < 0 ) {
+			pthread_cond_wait( &reader->cond, &reader->mutex );
+		} else if ( pthread_cond_timedwait(&reader->cond, &reader->mutex, &deadline) ) {
+			break;
+		}
+	}
+
+	atomic_fetch_sub( &reader->waiting, 1 );
+	pthread_mutex_unlock( &reader->mutex );
+
+	return NULL;
+}
+
+
+/*
+ * Unblocking function for waits; only ends the wait it was given, since other
+ * threads may be waiting on the same reader.
+ */
+static void
+rzyre_reader_wait_ubf( void *wait_call )
+{
+	reader_wait_call_t *call = (reader_wait_call_t *)wait_call;
+	rzyre_reader_t *reader = call->reader;
+
+	pthread_mutex_lock( &reader->mutex );
+	call->interrupted = TRUE;
+	pthread_cond_broadcast( &reader->cond );
+	pthread_mutex_unlock( &reader->mutex );
+}
+
+
+/*
+ * Wait up to +timeout+ milliseconds (or indefinitely if +timeout+ is -1) for the
+ * ring to have an event in it, with the GVL released. Returns true if it does.
+ */
+int
+rzyre_reader_wait( rzyre_reader_t *reader, int timeout )
+{
+	reader_wait_call_t call = { reader, timeout, FALSE };
+
+	if ( atomic_load(&reader->tail) != atomic_load(&reader->head) ) return TRUE;
+	if ( timeout == 0 ) return FALSE;
+
+	rb_thread_call_without_gvl2( rzyre_reader_wait_without_gvl, (void *)&call,
+		rzyre_reader_wait_ubf, (void *)&call );
+
+	return atomic_load( &reader->tail ) != atomic_load( &reader->head );
+}
+
+
+/*
+ * Fill in the reader's +counters+.
+ */
+void
+rzyre_reader_counters( rzyre_reader_t *reader, rzyre_reader_counters_t *counters )
+{
+	const size_t head = atomic_load( &reader->head );
+
+	counters->capacity = reader->capacity;
+	counters->depth = atomic_load( &reader->tail ) - head;
+	counters->high_water = atomic_load( &reader->high_water );
+	counters->overflows = atomic_load( &reader->overflows );
+	counters->running = atomic_load( &reader->running );
+}
+
+
+/*
+ * Add the counts for the frames the reader has decompressed to the +stats+.
+ */
+void
+rzyre_reader_add_stats( rzyre_reader_t *reader, rzyre_compression_stats_t *stats )
+{
+	pthread_mutex_lock( &reader->mutex );
+	rzyre_compression_stats_add( stats, &reader->stats );
+	pthread_mutex_unlock( &reader->mutex );
+}
+
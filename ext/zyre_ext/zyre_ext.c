@@ -16,8 +16,63 @@ VALUE rzyre_mZyre;
  * Logging Functions
  * -------------------------------------------------------------- */
 
+// The level of the Zyre logger, kept in sync with it by Zyre.native_log_level=
+int rzyre_log_level = RZYRE_LOG_DEBUG;
+
+static ID id_log;
+static ID id_logger;
+static ID rzyre_log_level_ids[ RZYRE_LOG_UNKNOWN + 1 ];
+
+#ifdef HAVE_RB_RACTOR_LOCAL_STORAGE_PTR_NEWKEY
+// Ractor-local storage that's only set in the main Ractor
+static rb_ractor_local_key_t rzyre_main_ractor_key;
+
+
+/*
+ * Returns true if called from the main Ractor.
+ */
+int
+rzyre_main_ractor_p( void )
+{
+	return rb_ractor_local_storage_ptr( rzyre_main_ractor_key ) != NULL;
+}
+#endif
+
+
+/*
+ * Return the log level for the given level +name+ (e.g., "debug"). Only the
+ * first character is significant.
+ */
+int
+rzyre_log_level_from_name( const char *name )
+{
+	switch ( name[0] ) {
+		case 'd': case 'D': return RZYRE_LOG_DEBUG;
+		case 'i': case 'I': return RZYRE_LOG_INFO;
+		case 'w': case 'W': return RZYRE_LOG_WARN;
+		case 'e': case 'E': return RZYRE_LOG_ERROR;
+		case 'f': case 'F': return RZYRE_LOG_FATAL;
+		default: return RZYRE_LOG_UNKNOWN;
+	}
+}
+
+
+/*
+ * Send the formatted message to the +logger+ at the given +level+.
+ */
+static void
+rzyre_log_message( VALUE logger, int level, const char *fmt, va_list args )
+{
+	char buf[BUFSIZ];
+
+	vsnprintf( buf, BUFSIZ, fmt, args );
+	rb_funcall( logger, rzyre_log_level_ids[level], 1, rb_str_new2(buf) );
+}
+
+
 /*
- * Log a message to the given +context+ object's logger.
+ * Log a message to the given +context+ object's logger. Messages logged outside
+ * of the main Ractor are discarded, since the logger can't be shared.
  */
 void
 #ifdef HAVE_STDARG_PROTOTYPES
@@ -26,24 +81,20 @@ rzyre_log_obj( VALUE context, const char *level, const char *fmt, ... )
 rzyre_log_obj( VALUE context, const char *level, const char *fmt, va_dcl )
 #endif
 {
-	char buf[BUFSIZ];
 	va_list	args;
-	VALUE logger = Qnil;
-	VALUE message = Qnil;
-
-	va_init_list( args, fmt );
-	vsnprintf( buf, BUFSIZ, fmt, args );
-	message = rb_str_new2( buf );
+	const int level_num = rzyre_log_level_from_name( level );
 
-	logger = rb_funcall( context, rb_intern("log"), 0 );
-	rb_funcall( logger, rb_intern(level), 1, message );
+	if ( level_num < rzyre_log_level || !RZYRE_MAIN_RACTOR_P() ) return;
 
+	va_init_list( args, fmt );
+	rzyre_log_message( rb_funcall(context, id_log, 0), level_num, fmt, args );
 	va_end( args );
 }
 
 
 /*
- * Log a message to the global logger.
+ * Log a message to the global logger. Like rzyre_log_obj(), only logs in the main
+ * Ractor.
  */
 void
 #ifdef HAVE_STDARG_PROTOTYPES
@@ -52,19 +103,56 @@ rzyre_log( const char *level, const char *fmt, ... )
 rzyre_log( const char *level, const char *fmt, va_dcl )
 #endif
 {
-	char buf[BUFSIZ];
 	va_list	args;
-	VALUE logger = Qnil;
-	VALUE message = Qnil;
+	const int level_num = rzyre_log_level_from_name( level );
+
+	if ( level_num < rzyre_log_level || !RZYRE_MAIN_RACTOR_P() ) return;
 
 	va_init_list( args, fmt );
-	vsnprintf( buf, BUFSIZ, fmt, args );
-	message = rb_str_new2( buf );
+	rzyre_log_message( rb_funcall(rzyre_mZyre, id_logger, 0), level_num, fmt, args );
+	va_end( args );
+}
 
-	logger = rb_funcall( rzyre_mZyre, rb_intern("logger"), 0 );
-	rb_funcall( logger, rb_intern(level), 1, message );
 
-	va_end( args );
+/*
+ * call-seq:
+ *    Zyre.native_log_level = level
+ *
+ * Tell the native extension which +level+ the Zyre logger is logging at, as either
+ * a Logger severity Integer or a level name like <tt>:info</tt>. Messages below that
+ * level are discarded before they're formatted. This is called by the logger
+ * itself whenever its level changes, so you shouldn't need to call it yourself.
+ *
+ */
+static VALUE
+rzyre_s_native_log_level_eq( VALUE module, VALUE level )
+{
+	if ( RB_INTEGER_TYPE_P(level) ) {
+		const int level_num = NUM2INT( level );
+		rzyre_log_level = level_num < RZYRE_LOG_DEBUG ? RZYRE_LOG_DEBUG :
+			level_num > RZYRE_LOG_UNKNOWN ? RZYRE_LOG_UNKNOWN : level_num;
+	} else {
+		VALUE level_name = rb_obj_as_string( level );
+		rzyre_log_level = RSTRING_LEN( level_name ) ?
+			rzyre_log_level_from_name( RSTRING_PTR(level_name) ) : RZYRE_LOG_DEBUG;
+	}
+
+	return level;
+}
+
+
+/*
+ * call-seq:
+ *    Zyre.native_log_level   -> integer
+ *
+ * Return the log level the native extension is currently logging at as a Logger
+ * severity Integer.
+ *
+ */
+static VALUE
+rzyre_s_native_log_level( VALUE module )
+{
+	return INT2FIX( rzyre_log_level );
 }
 
 
@@ -72,16 +160,238 @@ rzyre_log( const char *level, const char *fmt, va_dcl )
  * Utility functions
  * -------------------------------------------------------------- */
 
+/*
+ * Return a deduplicated frozen String for the given +cstr+, so values that
+ * recur across many events (peer UUIDs, group names, etc.) share one object.
+ */
+VALUE
+rzyre_interned_str( const char *cstr )
+{
+#ifdef HAVE_RB_ENC_INTERNED_STR_CSTR
+	return rb_enc_interned_str_cstr( cstr, rb_ascii8bit_encoding() );
+#else
+	static ID id_uminus;
+
+	if ( !id_uminus ) CONST_ID( id_uminus, "-@" );
+	return rb_funcall( rb_str_new2(cstr), id_uminus, 0 );
+#endif
+}
+
+
+/*
+ * Return a frozen Hash with the (interned) keys and values of the given
+ * +headers+. If +headers+ is NULL, the Hash is empty.
+ */
+VALUE
+rzyre_frozen_hash_from_zhash( zhash_t *headers )
+{
+	VALUE rhash = rb_hash_new();
+	const char *val;
+
+	if ( headers ) {
+		for ( val = zhash_first(headers) ; val ; val = zhash_next(headers) ) {
+			rb_hash_aset( rhash, rzyre_interned_str(zhash_cursor(headers)),
+				rzyre_interned_str(val) );
+		}
+	}
+
+	return rb_obj_freeze( rhash );
+}
+
+
+/*
+ * Strings which have been handed to czmq without being copied. Each one stays
+ * in this list (and is marked, which also pins it in place for the compacting
+ * GC) until libzmq is done with the message that points at it, which can happen
+ * on one of libzmq's threads (or from another Ractor), so the list is only
+ * touched under the mutex.
+ */
+typedef struct rzyre_pinned_string {
+	VALUE string;
+	int released;
+	struct rzyre_pinned_string *next;
+} rzyre_pinned_string_t;
+
+static rzyre_pinned_string_t *rzyre_pinned_strings = NULL;
+static pthread_mutex_t rzyre_pinned_strings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static VALUE rzyre_pinned_strings_holder = Qnil;
+
+/*
+ * A connected pair of inproc sockets for making frames out of zmq messages. czmq
+ * can only make a frame around memory it doesn't own with zframe_frommem(), whose
+ * destructor runs as soon as the frame is destroyed (e.g., right after it's been
+ * sent) rather than when libzmq is done with the memory. A message made with
+ * zmq_msg_init_data() has a free function that libzmq calls at the right time, and
+ * receiving it from a socket is the only way to get it into a frame.
+ */
+static zsock_t *rzyre_loopback_in = NULL;
+static zsock_t *rzyre_loopback_out = NULL;
+static pthread_mutex_t rzyre_loopback_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Getting a frame through the loopback costs a mutex and a round-trip through
+// libzmq, which is more than copying a small String does, so only Strings at least
+// this big are sent without copying them
+#define RZYRE_ZERO_COPY_MIN_SIZE 65536
+
+
+/*
+ * Mark function for the object which keeps the pinned strings alive.
+ */
+static void
+rzyre_pinned_strings_mark( void *ptr )
+{
+	rzyre_pinned_string_t *pin = *(rzyre_pinned_string_t **)ptr;
+
+	while ( pin ) {
+		rb_gc_mark( pin->string );
+		pin = pin->next;
+	}
+}
+
+static const rb_data_type_t rzyre_pinned_strings_t = {
+	"Zyre::PinnedStrings",
+	{
+		rzyre_pinned_strings_mark,
+		NULL
+	},
+	0,
+	0,
+	RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+
+/*
+ * Make a frame that refers to the +size+ bytes at +data+ instead of copying them.
+ * libzmq calls +ffn+ with the +data+ and +hint+ once nothing refers to them
+ * anymore, from whichever thread lets go of them last. Returns NULL if the frame
+ * couldn't be made, in which case +ffn+ may already have been called.
+ */
+static zframe_t *
+rzyre_frame_from_data( void *data, size_t size, zmq_free_fn *ffn, void *hint )
+{
+	zframe_t *frame = NULL;
+	zmq_msg_t msg;
+	char endpoint[ 64 ];
+
+	pthread_mutex_lock( &rzyre_loopback_mutex );
+
+	if ( !rzyre_loopback_in ) {
+		snprintf( endpoint, sizeof endpoint, "@inproc://rzyre-loopback-%p",
+			(void *)&rzyre_loopback_mutex );
+		rzyre_loopback_in = zsock_new_pair( endpoint );
+		endpoint[0] = '>';
+		rzyre_loopback_out = zsock_new_pair( endpoint );
+	}
+
+	if ( rzyre_loopback_in && rzyre_loopback_out &&
+		zmq_msg_init_data(&msg, data, size, ffn, hint) == 0 )
+	{
+		if ( zmq_msg_send(&msg, zsock_resolve(rzyre_loopback_out), 0) < 0 ) {
+			zmq_msg_close( &msg );
+		} else {
+			frame = zframe_recv( rzyre_loopback_in );
+		}
+	}
+
+	pthread_mutex_unlock( &rzyre_loopback_mutex );
+
+	return frame;
+}
+
+
+/*
+ * Close the loopback sockets before czmq shuts down, so they aren't reported as
+ * dangling.
+ */
+static void
+rzyre_close_loopback( VALUE unused )
+{
+	pthread_mutex_lock( &rzyre_loopback_mutex );
+	zsock_destroy( &rzyre_loopback_out );
+	zsock_destroy( &rzyre_loopback_in );
+	pthread_mutex_unlock( &rzyre_loopback_mutex );
+}
+
+
+/*
+ * Free function for messages built from pinned Strings; called by libzmq, possibly
+ * from one of its own threads.
+ */
+static void
+rzyre_release_pinned_string( void *data, void *hint )
+{
+	rzyre_pinned_string_t *pin = (rzyre_pinned_string_t *)hint;
+
+	pthread_mutex_lock( &rzyre_pinned_strings_mutex );
+	pin->released = TRUE;
+	pthread_mutex_unlock( &rzyre_pinned_strings_mutex );
+}
+
+
+/*
+ * Drop pinned Strings whose messages libzmq is done with. Must be called with the
+ * GVL.
+ */
+static void
+rzyre_sweep_pinned_strings( void )
+{
+	rzyre_pinned_string_t **link = &rzyre_pinned_strings, *pin;
+
+	pthread_mutex_lock( &rzyre_pinned_strings_mutex );
+	while ( (pin = *link) ) {
+		if ( pin->released ) {
+			*link = pin->next;
+			xfree( pin );
+		} else {
+			link = &pin->next;
+		}
+	}
+	pthread_mutex_unlock( &rzyre_pinned_strings_mutex );
+}
+
+
+/*
+ * Make a frame that points at the contents of the given frozen +string+ instead of
+ * copying them, and keep the String alive until libzmq is done with them. Returns
+ * NULL if the frame couldn't be made, in which case the String should be copied.
+ */
+static zframe_t *
+rzyre_make_pinned_frame( VALUE string )
+{
+	rzyre_pinned_string_t *pin = ALLOC( rzyre_pinned_string_t );
+	zframe_t *frame;
+
+	pin->string = string;
+	pin->released = FALSE;
+
+	pthread_mutex_lock( &rzyre_pinned_strings_mutex );
+	pin->next = rzyre_pinned_strings;
+	rzyre_pinned_strings = pin;
+	pthread_mutex_unlock( &rzyre_pinned_strings_mutex );
+
+	frame = rzyre_frame_from_data( RSTRING_PTR(string), RSTRING_LEN(string),
+		rzyre_release_pinned_string, pin );
+
+	// The free function won't necessarily have run if the frame couldn't be made,
+	// and the String is about to be copied instead, so let the next sweep drop it
+	if ( !frame ) rzyre_release_pinned_string( NULL, pin );
+
+	return frame;
+}
+
+
 // Struct for passing arguments through rb_protect to rzyre_add_frames_to_zmsg()
 struct add_frames_to_zmsg_call {
 	zmsg_t *msg;
 	VALUE msg_parts;
+	int zero_copy;
 };
 typedef struct add_frames_to_zmsg_call add_frames_to_zmsg_call_t;
 
 
 /*
- * Add a frame for each object in an Array.
+ * Add a frame for each object in an Array. Frames are built from the String's
+ * length rather than a NUL terminator, so they can contain arbitrary bytes.
  */
 static VALUE
 rzyre_add_frames_to_zmsg( VALUE call )
@@ -91,7 +401,20 @@ rzyre_add_frames_to_zmsg( VALUE call )
 
 	for ( long i = 0 ; i < RARRAY_LEN(call_ptr->msg_parts) ; i++ ) {
 		msg_part = rb_ary_entry( call_ptr->msg_parts, i );
-		zmsg_addstr( call_ptr->msg, StringValueCStr(msg_part) );
+		StringValue( msg_part );
+
+		if ( call_ptr->zero_copy && OBJ_FROZEN(msg_part) &&
+			RSTRING_LEN(msg_part) >= RZYRE_ZERO_COPY_MIN_SIZE )
+		{
+			zframe_t *frame = rzyre_make_pinned_frame( msg_part );
+
+			if ( frame ) {
+				zmsg_append( call_ptr->msg, &frame );
+				continue;
+			}
+		}
+
+		zmsg_addmem( call_ptr->msg, RSTRING_PTR(msg_part), RSTRING_LEN(msg_part) );
 	}
 
 	return Qtrue;
@@ -100,18 +423,18 @@ rzyre_add_frames_to_zmsg( VALUE call )
 
 /*
  * Make and return a zmsg, with one frame per object in +messages+. Caller owns the returned
- * zmsg. Can raise a TypeError if one of the +messages+ can't be stringified.
+ * zmsg. Can raise a TypeError if one of the +messages+ can't be stringified. If +zero_copy+
+ * is true, large frozen Strings are handed to czmq without being copied.
  */
 zmsg_t *
-rzyre_make_zmsg_from( VALUE messages )
+rzyre_make_zmsg_from( VALUE messages, int zero_copy )
 {
 	VALUE msgarray = rb_Array( messages );
 	zmsg_t *msg = zmsg_new();
-	static add_frames_to_zmsg_call_t call;
+	add_frames_to_zmsg_call_t call = { msg, msgarray, zero_copy };
 	int state;
 
-	call.msg = msg;
-	call.msg_parts = msgarray;
+	if ( zero_copy ) rzyre_sweep_pinned_strings();
 
 	rb_protect( rzyre_add_frames_to_zmsg, (VALUE)&call, &state );
 
@@ -126,7 +449,6 @@ rzyre_make_zmsg_from( VALUE messages )
 
 
 
-
 /* --------------------------------------------------------------
  * Module methods
  * -------------------------------------------------------------- */
@@ -141,9 +463,7 @@ rzyre_make_zmsg_from( VALUE messages )
 static VALUE
 rzyre_s_zyre_version()
 {
-	static uint64_t version;
-
-	version = zyre_version();
+	const uint64_t version = zyre_version();
 
 	return INT2NUM( version );
 }
@@ -192,21 +512,151 @@ rzyre_s_interfaces()
 }
 
 
+// Struct for passing arguments to rzyre_s_wait2_poll() and
+// rzyre_s_wait2_without_gvl()
+typedef struct {
+	VALUE nodes;
+	zmq_pollitem_t *items;
+	int count;
+	int timeout;
+	int ready;
+} wait2_call_t;
+
+
+/*
+ * Async poll function for Zyre.wait2; called without the GVL.
+ */
+static void *
+rzyre_s_wait2_without_gvl( void *wait_call )
+{
+	wait2_call_t *call = (wait2_call_t *)wait_call;
+
+	call->ready = zmq_poll( call->items, call->count, call->timeout );
+
+	return NULL;
+}
+
+
+/*
+ * Poll the call's nodes, through the current Fiber scheduler if there is one.
+ */
+static VALUE
+rzyre_s_wait2_poll( VALUE wait_call )
+{
+	wait2_call_t *call = (wait2_call_t *)wait_call;
+
+	if ( RZYRE_FIBER_SCHEDULER_P() ) {
+		call->ready = rzyre_fiber_poll( (VALUE *)RARRAY_CONST_PTR(call->nodes), call->items,
+			call->count, call->timeout );
+	} else {
+		rb_thread_call_without_gvl2( rzyre_s_wait2_without_gvl, (void *)call, RUBY_UBF_IO, 0 );
+	}
+
+	return Qnil;
+}
+
+
+/*
+ * call-seq:
+ *    Zyre.wait2( nodes, timeout=-1 )   -> node or nil
+ *
+ * Wait on the given Array of +nodes+ to become readable, returning the first one
+ * (in the order given) that does, or +nil+ if the +timeout+ (in floating-point
+ * seconds, or -1 to wait indefinitely) expires first. The nodes' sockets are
+ * polled directly, so unlike a Zyre::Poller this doesn't allocate anything for
+ * reasonable numbers of nodes. If there is a Fiber scheduler active, only the
+ * current fiber waits. Zyre.wait is the friendlier interface to this.
+ *
+ */
+static VALUE
+rzyre_s_wait2( int argc, VALUE *argv, VALUE module )
+{
+	VALUE nodes, timeout_arg, tmpbuf, rval = Qnil;
+	wait2_call_t call;
+	long i;
+
+	rb_scan_args( argc, argv, "11", &nodes, &timeout_arg );
+	Check_Type( nodes, T_ARRAY );
+
+	// Other fibers can change the Array while this one waits, so poll a copy
+	nodes = rb_ary_freeze( rb_ary_dup(nodes) );
+
+	call.timeout = -1;
+	if ( !NIL_P(timeout_arg) ) call.timeout = floor( NUM2DBL(timeout_arg) * 1000 );
+	call.count = (int)RARRAY_LEN( nodes );
+	call.ready = 0;
+	if ( !call.count ) return Qnil;
+
+	// ALLOCV_N uses the stack unless there are a great many nodes
+	call.items = ALLOCV_N( zmq_pollitem_t, tmpbuf, call.count );
+	for ( i = 0 ; i < call.count ; i++ ) {
+		zyre_t *node = rzyre_get_node( RARRAY_AREF(nodes, i) );
+
+		call.items[ i ].socket = zsock_resolve( zyre_socket(node) );
+		call.items[ i ].fd = 0;
+		call.items[ i ].events = ZMQ_POLLIN;
+		call.items[ i ].revents = 0;
+	}
+
+	call.nodes = nodes;
+	rzyre_nodes_polling( nodes, rzyre_s_wait2_poll, (VALUE)&call );
+
+	if ( call.ready > 0 ) {
+		for ( i = 0 ; i < call.count ; i++ ) {
+			if ( call.items[i].revents & ZMQ_POLLIN ) {
+				rval = RARRAY_AREF( nodes, i );
+				break;
+			}
+		}
+	}
+
+	ALLOCV_END( tmpbuf );
+
+	return rval;
+}
+
+
 /*
  * Zyre extension init function
  */
 void
 Init_zyre_ext()
 {
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+	rb_ext_ractor_safe( true );
+#endif
+#ifdef HAVE_RB_RACTOR_LOCAL_STORAGE_PTR_NEWKEY
+	rzyre_main_ractor_key = rb_ractor_local_storage_ptr_newkey( NULL );
+	rb_ractor_local_storage_ptr_set( rzyre_main_ractor_key, &rzyre_main_ractor_key );
+#endif
+
 	rzyre_mZyre = rb_define_module( "Zyre" );
 
 	rb_define_singleton_method( rzyre_mZyre, "zyre_version", rzyre_s_zyre_version, 0 );
 	rb_define_singleton_method( rzyre_mZyre, "interfaces", rzyre_s_interfaces, 0 );
-
-	// :TODO: set up zsys_set_logsender()
+	rb_define_singleton_method( rzyre_mZyre, "wait2", rzyre_s_wait2, -1 );
+	rb_define_singleton_method( rzyre_mZyre, "native_log_level", rzyre_s_native_log_level, 0 );
+	rb_define_singleton_method( rzyre_mZyre, "native_log_level=", rzyre_s_native_log_level_eq, 1 );
+
+	id_log = rb_intern( "log" );
+	id_logger = rb_intern( "logger" );
+	rzyre_log_level_ids[ RZYRE_LOG_DEBUG ] = rb_intern( "debug" );
+	rzyre_log_level_ids[ RZYRE_LOG_INFO ] = rb_intern( "info" );
+	rzyre_log_level_ids[ RZYRE_LOG_WARN ] = rb_intern( "warn" );
+	rzyre_log_level_ids[ RZYRE_LOG_ERROR ] = rb_intern( "error" );
+	rzyre_log_level_ids[ RZYRE_LOG_FATAL ] = rb_intern( "fatal" );
+	rzyre_log_level_ids[ RZYRE_LOG_UNKNOWN ] = rb_intern( "unknown" );
+
+	rzyre_pinned_strings_holder = TypedData_Wrap_Struct( 0, &rzyre_pinned_strings_t,
+		&rzyre_pinned_strings );
+	rb_gc_register_mark_object( rzyre_pinned_strings_holder );
+	rb_set_end_proc( rzyre_close_loopback, Qnil );
 
 	rzyre_init_node();
 	rzyre_init_event();
 	rzyre_init_poller();
+	rzyre_init_log_bridge();
+	rzyre_init_codec();
+	rzyre_init_reactor();
 }
 
@@ -14,11 +14,21 @@
 #include <ruby/intern.h>
 #include <ruby/thread.h>
 #include <ruby/encoding.h>
+#include <ruby/io.h>
+#ifdef HAVE_RUBY_FIBER_SCHEDULER_H
+# include <ruby/fiber/scheduler.h>
+#endif
+
+#include <pthread.h>
 
 #include "zyre.h"
 #include "czmq.h"
 #include "extconf.h"
 
+#ifdef HAVE_RUBY_RACTOR_H
+# include <ruby/ractor.h>
+#endif
+
 #ifndef TRUE
 # define TRUE    1
 #endif
@@ -27,6 +37,14 @@
 # define FALSE   0
 #endif
 
+// Only the main Ractor can use the logger (and other unshareable Ruby objects)
+#ifdef HAVE_RB_RACTOR_LOCAL_STORAGE_PTR_NEWKEY
+# define RZYRE_MAIN_RACTOR_P() rzyre_main_ractor_p()
+extern int rzyre_main_ractor_p _(( void ));
+#else
+# define RZYRE_MAIN_RACTOR_P() TRUE
+#endif
+
 
 // For synthesized events
 struct _zyre_event_t {
@@ -44,6 +62,23 @@ struct _zyre_event_t {
  * Declarations
  * -------------------------------------------------------------- */
 
+// Log levels, in the same order as Logger's
+enum rzyre_log_level {
+	RZYRE_LOG_DEBUG,
+	RZYRE_LOG_INFO,
+	RZYRE_LOG_WARN,
+	RZYRE_LOG_ERROR,
+	RZYRE_LOG_FATAL,
+	RZYRE_LOG_UNKNOWN
+};
+
+extern int rzyre_log_level;
+extern int rzyre_log_level_from_name _(( const char * ));
+
+// True if a message at the given level (e.g., "debug") would be logged
+#define rzyre_log_enabled( level ) \
+	( rzyre_log_level_from_name(level) >= rzyre_log_level && RZYRE_MAIN_RACTOR_P() )
+
 #ifdef HAVE_STDARG_PROTOTYPES
 #include <stdarg.h>
 #define va_init_list(a,b) va_start(a,b)
@@ -61,6 +96,128 @@ void rzyre_log( const char *, const char *, va_dcl );
  * Structs
  * -------------------------------------------------------------- */
 
+// A node's local directory of peers and groups, kept up to date from the
+// membership events the node receives
+struct rzyre_node_directory {
+	VALUE peers;               //  Peer UUID -> Hash of the names of the peer's groups
+	VALUE groups;              //  Group name -> Hash of the UUIDs of its members
+	VALUE own_groups;          //  Hash of the names of the node's own groups
+	VALUE peer_info;           //  Peer UUID -> frozen Hash of what its ENTER said
+	unsigned long generation;  //  Incremented whenever membership changes
+};
+typedef struct rzyre_node_directory rzyre_node_directory_t;
+
+// Counters for the frames a node has compressed or decompressed
+struct rzyre_compression_stats {
+	unsigned long frames;                //  The number of frames
+	unsigned long long raw_bytes;        //  Their total uncompressed size
+	unsigned long long compressed_bytes; //  Their total compressed size
+	unsigned long long cpu_ns;           //  CPU time spent, in nanoseconds
+};
+typedef struct rzyre_compression_stats rzyre_compression_stats_t;
+
+// The bit in masks of event types for types the extension doesn't know about; see
+// rzyre_event_type_bit()
+#define RZYRE_EVENT_TYPE_OTHER ( 1U << 31 )
+
+// A mask of every event type
+#define RZYRE_EVENT_TYPE_ALL ( ~0U )
+
+// A node's background reader; see reader.c
+typedef struct rzyre_reader rzyre_reader_t;
+
+// A snapshot of a background reader's counters
+struct rzyre_reader_counters {
+	size_t capacity;          //  The number of events the ring can hold
+	size_t depth;             //  The number of events in the ring
+	size_t high_water;        //  The most events the ring has held
+	unsigned long overflows;  //  Events dropped because the ring was full
+	int running;              //  True if the reader is still reading events
+};
+typedef struct rzyre_reader_counters rzyre_reader_counters_t;
+
+// A node's event filter; see filter.c
+typedef struct rzyre_event_filter rzyre_event_filter_t;
+
+// What a node's filter decided about an event
+enum rzyre_filter_result {
+	RZYRE_FILTER_PASS,     //  Deliver it
+	RZYRE_FILTER_OBSERVE,  //  Don't deliver it, but the local directory needs to see it
+	RZYRE_FILTER_DROP      //  Destroy it
+};
+
+// Counts of the events a node's filter has dropped, by reason
+struct rzyre_filter_counters {
+	unsigned long types;    //  Not one of the filter's types
+	unsigned long peers;    //  From a peer that's denied or not allowed
+	unsigned long groups;   //  For a group that isn't in the filter's groups
+};
+typedef struct rzyre_filter_counters rzyre_filter_counters_t;
+
+// The data wrapped by a Zyre::Node
+struct rzyre_node_data {
+	zyre_t *node;           //  The wrapped zyre node
+	int zero_copy;          //  Send frozen Strings without copying them
+	VALUE io;               //  An IO for the node's ZMQ_FD, for Fiber schedulers
+	rzyre_node_directory_t *directory;  //  The local directory, if it's enabled
+	int compression;        //  Compress outgoing and decompress incoming frames
+	size_t compression_threshold;          //  Only compress frames larger than this
+	rzyre_compression_stats_t compressed;    //  Frames compressed before sending
+	rzyre_compression_stats_t decompressed;  //  Frames decompressed after receiving
+	rzyre_reader_t *reader;  //  The background reader, if one has been started
+	int polled;             //  The number of waits and reactors polling the node
+	rzyre_event_filter_t *filter;      //  The event filter, if one has been set
+	VALUE filter_config;               //  The Hash the filter was made from
+	rzyre_filter_counters_t filtered;  //  Events the filter has dropped
+	int observing;                     //  Set while the local directory is enabled
+	pthread_mutex_t filter_mutex;      //  Guards the filter, its counters, and +observing+
+	pthread_mutex_t actor_mutex;       //  Serializes use of the zyre actor's pipe
+};
+typedef struct rzyre_node_data rzyre_node_data_t;
+
+// A node registered with a Zyre::Poller
+struct rzyre_poller_entry {
+	VALUE node;             //  The Zyre::Node
+	zsock_t *socket;        //  The node's socket
+	unsigned long served;   //  When #wait_all last returned the node
+};
+typedef struct rzyre_poller_entry rzyre_poller_entry_t;
+
+// The data wrapped by a Zyre::Poller
+struct rzyre_poller_data {
+	zpoller_t *poller;      //  The czmq poller used by #wait
+	st_table *entries;      //  The registered nodes, keyed by socket
+	unsigned long serial;   //  The number of times #wait_all has served nodes
+	long cursor;            //  Where #wait_all's next round-robin scan starts
+};
+typedef struct rzyre_poller_data rzyre_poller_data_t;
+
+// A node registered with a Zyre::Reactor
+struct rzyre_reactor_entry {
+	struct rzyre_reactor_data *reactor;  //  The reactor it's registered with
+	VALUE node;             //  The Zyre::Node
+	rzyre_node_data_t *node_data;  //  The node's data
+	zsock_t *socket;        //  The node's socket
+	VALUE handlers;         //  Array of [ type mask, handler ] pairs
+	unsigned int mask;      //  The event types any of the handlers are for
+	rzyre_compression_stats_t stats;  //  Decompressed frames the node hasn't counted yet
+	int polling;            //  Set while the node is counted as polled by the reactor
+};
+typedef struct rzyre_reactor_entry rzyre_reactor_entry_t;
+
+// The data wrapped by a Zyre::Reactor
+struct rzyre_reactor_data {
+	zloop_t *loop;          //  The czmq event loop
+	st_table *entries;      //  The registered nodes, keyed by socket
+	VALUE timers;           //  Timer ID -> [ handler, remaining count ]
+	VALUE thread;           //  The Thread running the loop, or nil
+	VALUE error;            //  An exception raised by a handler
+	int stopping;           //  Set when the loop has been asked to stop
+	int result;             //  What the last zloop_start() returned
+	int wakeup[2];          //  Pipe for waking the loop from other threads
+	zmq_pollitem_t wakeup_item;  //  The loop's poll item for the wakeup pipe
+};
+typedef struct rzyre_reactor_data rzyre_reactor_data_t;
 
 
 /* -------------------------------------------------------
@@ -74,6 +231,9 @@ extern VALUE rzyre_mZyre;
 extern VALUE rzyre_cZyreNode;
 extern VALUE rzyre_cZyreEvent;
 extern VALUE rzyre_cZyrePoller;
+extern VALUE rzyre_mZyreLogBridge;
+extern VALUE rzyre_mZyreCodec;
+extern VALUE rzyre_cZyreReactor;
 
 
 /* --------------------------------------------------------------
@@ -83,11 +243,52 @@ extern VALUE rzyre_cZyrePoller;
 #define IsZyreNode( obj ) rb_obj_is_kind_of( (obj), rzyre_cZyreNode )
 #define IsZyreEvent( obj ) rb_obj_is_kind_of( (obj), rzyre_cZyreEvent )
 #define IsZyrePoller( obj ) rb_obj_is_kind_of( (obj), rzyre_cZyrePoller )
+#define IsZyreReactor( obj ) rb_obj_is_kind_of( (obj), rzyre_cZyreReactor )
+
+/* --------------------------------------------------------------
+ * Fiber scheduler support
+ * -------------------------------------------------------------- */
+
+#if defined(HAVE_RB_FIBER_SCHEDULER_CURRENT) && defined(HAVE_RB_IO_WAIT)
+# define RZYRE_FIBER_SCHEDULER_P() ( rb_fiber_scheduler_current() != Qnil )
+#else
+# define RZYRE_FIBER_SCHEDULER_P() 0
+#endif
+
 
 /* --------------------------------------------------------------
  * Utility functions
  * -------------------------------------------------------------- */
-extern zmsg_t * rzyre_make_zmsg_from _(( VALUE ));
+extern zmsg_t * rzyre_make_zmsg_from _(( VALUE, int ));
+extern VALUE rzyre_interned_str _(( const char * ));
+extern VALUE rzyre_frozen_hash_from_zhash _(( zhash_t * ));
+extern zframe_t * rzyre_encode_frame _(( VALUE ));
+extern VALUE rzyre_decode _(( const byte *, size_t ));
+extern void rzyre_compress_msg _(( zmsg_t *, size_t, rzyre_compression_stats_t * ));
+extern void rzyre_decompress_msg _(( zmsg_t *, rzyre_compression_stats_t * ));
+extern void rzyre_compression_stats_add _(( rzyre_compression_stats_t *, const rzyre_compression_stats_t * ));
+extern int rzyre_compression_available _(( void ));
+extern VALUE rzyre_read_event_from_node _(( VALUE, int ));
+extern VALUE rzyre_wrap_event _(( VALUE, zyre_event_t * ));
+extern unsigned int rzyre_event_type_bit _(( const char * ));
+extern unsigned int rzyre_event_type_bit_from_value _(( VALUE ));
+extern unsigned int rzyre_membership_event_mask;
+
+extern rzyre_reader_t * rzyre_reader_new _(( rzyre_node_data_t *, size_t ));
+extern void rzyre_reader_stop _(( rzyre_reader_t * ));
+extern void rzyre_reader_destroy _(( rzyre_reader_t ** ));
+extern rzyre_reader_t * rzyre_reader_ref _(( rzyre_reader_t * ));
+extern void rzyre_reader_release _(( rzyre_reader_t ** ));
+extern zyre_event_t * rzyre_reader_pop _(( rzyre_reader_t *, int * ));
+extern int rzyre_reader_active _(( rzyre_reader_t * ));
+extern int rzyre_reader_wait _(( rzyre_reader_t *, int ));
+extern void rzyre_reader_counters _(( rzyre_reader_t *, rzyre_reader_counters_t * ));
+extern void rzyre_reader_add_stats _(( rzyre_reader_t *, rzyre_compression_stats_t * ));
+
+extern rzyre_event_filter_t * rzyre_filter_new _(( unsigned int, VALUE, VALUE, VALUE ));
+extern void rzyre_filter_destroy _(( rzyre_event_filter_t ** ));
+extern int rzyre_filter_event _(( rzyre_node_data_t *, zyre_event_t * ));
+extern int rzyre_filter_observes _(( rzyre_node_data_t *, unsigned int ));
 
 
 /* -------------------------------------------------------
@@ -98,8 +299,19 @@ extern void Init_zyre_ext _(( void ));
 extern void rzyre_init_node _(( void ));
 extern void rzyre_init_event _(( void ));
 extern void rzyre_init_poller _(( void ));
+extern void rzyre_init_log_bridge _(( void ));
+extern void rzyre_init_codec _(( void ));
+extern void rzyre_init_reactor _(( void ));
 
 extern zyre_t * rzyre_get_node _(( VALUE ));
+extern rzyre_node_data_t * rzyre_get_node_data _(( VALUE ));
+extern VALUE rzyre_node_io _(( VALUE ));
+extern int rzyre_node_fiber_wait _(( VALUE, int ));
+extern void rzyre_node_observe_event _(( VALUE, zyre_event_t * ));
+extern rzyre_reader_t * rzyre_node_reader _(( VALUE ));
+extern void rzyre_node_check_reader _(( VALUE ));
+extern VALUE rzyre_nodes_polling _(( VALUE, VALUE (*)(VALUE), VALUE ));
+extern int rzyre_fiber_poll _(( VALUE *, zmq_pollitem_t *, int, int ));
 
 #endif /* end of include guard: ZYRE_EXT_H_90322ABD */
 
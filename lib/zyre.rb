@@ -19,6 +19,36 @@ module Zyre
 	log_as :zyre
 
 
+	# A mixin for the Zyre logger that mirrors changes to its level in the native
+	# extension, so it can skip formatting messages that won't be logged.
+	module LogLevelSync
+
+		### Set the logger's level to +newlevel+ and tell the extension about it.
+		def level=( newlevel )
+			super
+			Zyre.native_log_level = self.level
+		end
+
+	end # module LogLevelSync
+
+
+	### Replace the Zyre logger with +newlogger+, keeping the native log level in sync
+	### with it.
+	def self::logger=( newlogger )
+		super
+		self.sync_native_log_level
+	end
+
+
+	### Make the native extension log at the same level as the current logger, and
+	### follow any changes to it.
+	def self::sync_native_log_level
+		logger = self.logger
+		logger.extend( LogLevelSync ) unless logger.is_a?( LogLevelSync )
+		self.native_log_level = logger.level
+	end
+
+
 	### Wait on one or more +nodes+ to become readable, returning the first one that does
 	### or +nil+ if the +timeout+ is zero or greater and at least that many seconds elapse.
 	### Specify a +timeout+ of -1 to wait indefinitely. The timeout is in floating-point
@@ -50,4 +80,7 @@ module Zyre
 			transform_values {|v| v.to_s.encode('us-ascii') }
 	end
 
+
+	self.sync_native_log_level
+
 end # module Zyre
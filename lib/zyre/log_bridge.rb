@@ -0,0 +1,104 @@
+# -*- ruby -*-
+# frozen_string_literal: true
+
+require 'loggability'
+
+require 'zyre' unless defined?( Zyre )
+
+
+#--
+# See also: ext/zyre_ext/log_bridge.c
+module Zyre::LogBridge
+	extend Loggability
+
+	log_to :zyre
+
+
+	# The default number of lines to buffer before dropping them
+	DEFAULT_CAPACITY = 10_000
+
+	# The default maximum number of lines to forward to the logger at a time
+	DEFAULT_BATCH_SIZE = 100
+
+	# How long the forwarding thread waits for lines before checking if it's been stopped
+	DRAIN_TIMEOUT = 0.25
+
+	# Logger methods for czmq's log-level prefixes
+	LEVELS = {
+		'E' => :error,
+		'W' => :warn,
+		'N' => :info,
+		'I' => :info,
+		'D' => :debug,
+	}.freeze
+
+	# Pattern for splitting a czmq log line into its level and message
+	LOG_LINE_PATTERN = %r{
+		\A
+		(?<level>[EWNID]):\s+
+		(?:\d{2}-\d{2}-\d{2}\s\d{2}:\d{2}:\d{2}\s+)?
+		(?<message>.*)
+		\z
+	}xm
+
+
+	@thread = nil
+
+
+	### Start forwarding czmq and zyre log output to the :zyre logger from a background
+	### thread. Up to +capacity+ lines are buffered while waiting to be forwarded, and
+	### they're logged up to +batch_size+ at a time.
+	def self::start( capacity: DEFAULT_CAPACITY, batch_size: DEFAULT_BATCH_SIZE )
+		return false if @thread&.alive?
+
+		self.start_native( capacity )
+		@thread = Thread.new { self.forward_lines(batch_size) }
+		@thread.name = 'Zyre log bridge'
+
+		return true
+	end
+
+
+	### Stop forwarding log output and wait for any buffered lines to be logged.
+	### czmq logs to stderr again once the bridge is stopped.
+	def self::stop
+		return false unless @thread
+
+		self.stop_native
+		@thread.join
+		@thread = nil
+
+		return true
+	end
+
+
+	### Forward lines from the bridge to the logger in batches of up to +batch_size+
+	### until it's stopped.
+	def self::forward_lines( batch_size )
+		drops = 0
+
+		while lines = self.drain( batch_size, DRAIN_TIMEOUT )
+			lines.each {|line| self.forward_line(line) }
+
+			if self.drops > drops
+				self.log.warn "dropped %d czmq log lines" % [ self.drops - drops ]
+				drops = self.drops
+			end
+		end
+	end
+
+
+	### Log the given czmq log +line+ at the level indicated by its prefix.
+	def self::forward_line( line )
+		if ( match = LOG_LINE_PATTERN.match(line) )
+			self.log.public_send( LEVELS[match[:level]], match[:message] )
+		else
+			self.log.info( line )
+		end
+	end
+
+end # module Zyre::LogBridge
+
+
+at_exit { Zyre::LogBridge.stop }
+
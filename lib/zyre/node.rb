@@ -4,6 +4,7 @@
 require 'loggability'
 
 require 'zyre' unless defined?( Zyre )
+require 'zyre/stream'
 
 
 #--
@@ -27,6 +28,32 @@ class Zyre::Node
 	alias_method :each, :each_event
 
 
+	### Read up to +max+ of the events that are already waiting on the node, waiting
+	### up to +timeout+ seconds for the first one to arrive. Returns an Array of
+	### Zyre::Events, which is empty if the +timeout+ expires first. A +timeout+ of
+	### -1 means wait indefinitely.
+	def recv_batch( max: 100, timeout: -1 )
+		return Zyre::Event.batch_from_node( self, max, timeout )
+	end
+
+
+	### Stream the contents of +io+ to the peer with the given +peer_uuid+ in chunks of
+	### up to +chunk_size+ bytes, with no more than +window+ chunks waiting to be
+	### acknowledged at a time, so memory use depends on the window rather than the
+	### size of the payload. The peer writes the chunks out with a
+	### Zyre::Stream::Reassembler. Returns the number of bytes sent once they've all
+	### been acknowledged. Raises a Zyre::Stream::Error if the peer leaves or doesn't
+	### acknowledge a chunk within +timeout+ seconds. Any other events that arrive
+	### while streaming are passed to the block, if there is one.
+	def whisper_stream( peer_uuid, io, chunk_size: Zyre::Stream::DEFAULT_CHUNK_SIZE,
+		window: Zyre::Stream::DEFAULT_WINDOW, timeout: Zyre::Stream::DEFAULT_TIMEOUT, &block )
+
+		sender = Zyre::Stream::Sender.new( self, peer_uuid, io,
+			chunk_size: chunk_size, window: window, timeout: timeout )
+		return sender.run( &block )
+	end
+
+
 	### Wait for an event of a given +event_type+ (e.g., :JOIN) and matching any
 	### optional +criteria+, returning the event if a matching one was seen. If a
 	### +timeout+ is given and the event hasn't been seen after the +timeout+
@@ -93,9 +120,7 @@ class Zyre::Node
 	### Wait for an event of the given +event_class+ and +criteria+, returning it when it
 	### arrives. Blocks indefinitely until it arrives or interrupted.
 	def wait_for_indefinitely( event_class, **criteria, &block )
-		poller = Zyre::Poller.new( self )
-		while poller.wait
-			event = self.recv
+		while event = self.recv
 			if event.kind_of?( event_class ) && event.match( criteria )
 				return event
 			else
@@ -112,19 +137,14 @@ class Zyre::Node
 		start_time = get_monotime()
 		timeout_at = start_time + timeout
 
-		poller = Zyre::Poller.new( self )
-
 		timeout = timeout_at - get_monotime()
 		while timeout > 0
-			if poller.wait( timeout )
-				event = self.recv
-				if event.kind_of?( event_class ) && event.match( criteria )
-					return event
-				else
-					block.call( event ) if block
-				end
+			event = self.recv( timeout: timeout ) or break
+
+			if event.kind_of?( event_class ) && event.match( criteria )
+				return event
 			else
-				break
+				block.call( event ) if block
 			end
 
 			timeout = timeout_at - get_monotime()
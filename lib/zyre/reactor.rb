@@ -0,0 +1,39 @@
+# -*- ruby -*-
+# frozen_string_literal: true
+
+require 'loggability'
+
+require 'zyre' unless defined?( Zyre )
+
+
+#--
+# See also: ext/zyre_ext/reactor.c
+class Zyre::Reactor
+	extend Loggability
+
+	log_to :zyre
+
+
+	### Call the block once, after +delay+ seconds. Returns the ID of the timer.
+	def after( delay, &block )
+		return self.add_timer( delay, 1, &block )
+	end
+
+
+	### Call the block every +interval+ seconds until the timer is cancelled.
+	### Returns the ID of the timer.
+	def every( interval, &block )
+		return self.add_timer( interval, 0, &block )
+	end
+
+
+	### Run the reactor until it's stopped or +seconds+ have passed, whichever
+	### comes first.
+	def run_for( seconds )
+		timer_id = self.after( seconds ) { self.stop }
+		return self.run
+	ensure
+		self.cancel_timer( timer_id ) if timer_id
+	end
+
+end # class Zyre::Reactor
@@ -0,0 +1,394 @@
+# -*- ruby -*-
+# frozen_string_literal: true
+
+require 'securerandom'
+require 'loggability'
+
+require 'zyre' unless defined?( Zyre )
+
+
+# Chunked streaming of large payloads between two peers. The sender reads the
+# payload from an IO and whispers it as a sequence of chunks, keeping no more than
+# a window of them unacknowledged; the receiver writes each chunk out as it
+# arrives and acknowledges it, which gives the sender credit for another one. So
+# neither side holds more than a window of chunks in memory at a time.
+#
+# Each stream message is a whisper whose first frame is PROTOCOL, followed by:
+#
+#   DATA  <stream id> <sequence number> <chunk>
+#   ACK   <stream id> <number of chunks received>
+#   END   <stream id> <total number of chunks>
+#
+# See Zyre::Node#whisper_stream and Zyre::Stream::Reassembler.
+module Zyre::Stream
+	extend Loggability
+
+	log_to :zyre
+
+
+	# The first frame of every stream message
+	PROTOCOL = 'ZYRE-STREAM/1'
+
+	# The default size of each chunk, in bytes
+	DEFAULT_CHUNK_SIZE = 256 * 1024
+
+	# The default number of chunks the sender can have unacknowledged at a time
+	DEFAULT_WINDOW = 16
+
+	# The default number of seconds the sender waits for an acknowledgement
+	DEFAULT_TIMEOUT = 30
+
+
+	# Exception class for streams that fail partway through
+	class Error < RuntimeError; end
+
+	# The pattern stream IDs have to match
+	ID_PATTERN = /\A\h{16}\z/
+
+
+	### Returns +true+ if the given +event+ is a stream message.
+	def self::stream_event?( event )
+		return event.kind_of?( Zyre::Event::Whisper ) && event.frame( 0 ) == PROTOCOL
+	end
+
+
+	# The sending side of a stream; see Zyre::Node#whisper_stream.
+	class Sender
+		extend Loggability
+
+		log_to :zyre
+
+
+		### Create a sender that will stream the contents of +io+ from +node+ to the
+		### peer with the given +peer_uuid+.
+		def initialize( node, peer_uuid, io, chunk_size: DEFAULT_CHUNK_SIZE,
+			window: DEFAULT_WINDOW, timeout: DEFAULT_TIMEOUT )
+
+			raise ArgumentError, "chunk size must be at least 1" unless chunk_size >= 1
+			raise ArgumentError, "window must be at least 1" unless window >= 1
+
+			@node       = node
+			@peer_uuid  = peer_uuid
+			@io         = io
+			@chunk_size = chunk_size
+			@window     = window
+			@timeout    = timeout
+			@id         = SecureRandom.hex( 8 )
+
+			@buffer     = String.new( capacity: chunk_size, encoding: Encoding::BINARY )
+			@sent       = 0
+			@acked      = 0
+			@bytes      = 0
+			@eof        = false
+		end
+
+
+		######
+		public
+		######
+
+		##
+		# The ID of the stream
+		attr_reader :id
+
+		##
+		# The number of bytes sent so far
+		attr_reader :bytes
+
+
+		### Send the whole stream, returning the number of bytes sent once the peer has
+		### acknowledged all of it. Any other events that arrive at the node while
+		### waiting for acknowledgements are passed to the block, if there is one.
+		def run( &block )
+			self.log.debug "Streaming %p to %s as stream %s" % [ @io, @peer_uuid, @id ]
+
+			until @eof && @acked == @sent
+				self.send_chunks
+				self.wait_for_ack( &block ) unless @acked == @sent
+			end
+
+			@node.whisper( @peer_uuid, PROTOCOL, 'END', @id, @sent.to_s )
+			self.log.debug "Stream %s done: %d bytes in %d chunks" % [ @id, @bytes, @sent ]
+
+			return @bytes
+		end
+
+
+		#########
+		protected
+		#########
+
+		### Send chunks until the window is full or the IO runs out.
+		def send_chunks
+			while !@eof && @sent - @acked < @window
+				unless @io.read( @chunk_size, @buffer )
+					@eof = true
+					break
+				end
+
+				@node.whisper( @peer_uuid, PROTOCOL, 'DATA', @id, @sent.to_s, @buffer )
+				@sent += 1
+				@bytes += @buffer.bytesize
+			end
+		end
+
+
+		### Wait for the peer to acknowledge one or more chunks, passing any other events
+		### to the +block+.
+		def wait_for_ack( &block )
+			loop do
+				event = @node.wait_for( :WHISPER, timeout: @timeout, peer_uuid: @peer_uuid ) do |other|
+					if other.kind_of?( Zyre::Event::Exit ) && other.peer_uuid == @peer_uuid
+						raise Zyre::Stream::Error, "peer %s left during stream %s" % [ @peer_uuid, @id ]
+					end
+					block.call( other ) if block
+				end
+
+				raise Zyre::Stream::Error, "timed out waiting for stream %s to be acknowledged" % [ @id ] unless
+					event
+
+				if Zyre::Stream.stream_event?( event ) && event.frame( 1 ) == 'ACK' &&
+					event.frame( 2 ) == @id
+
+					@acked = [ @acked, event.frame(3).to_i ].max
+					return
+				end
+
+				block.call( event ) if block
+			end
+		end
+
+	end # class Sender
+
+
+	# The receiving side of a stream, which writes the chunks of incoming streams to
+	# an IO as they arrive. Pass it each event the node receives; it handles the
+	# stream messages, drops the unfinished streams of peers that exit, and ignores
+	# everything else:
+	#
+	#   reassembler = Zyre::Stream::Reassembler.new( node, '/var/spool/artifacts' )
+	#   node.each_event do |event|
+	#     if ( transfer = reassembler.handle(event) )
+	#       puts "received #{transfer.bytes} bytes" if transfer.complete?
+	#     else
+	#       # ...handle other events
+	#     end
+	#   end
+	class Reassembler
+		extend Loggability
+
+		log_to :zyre
+
+
+		# The state of one incoming stream
+		class Transfer
+
+			### Create a new transfer for the stream with the given +id+ from the peer
+			### with the given +peer_uuid+, to be written to +io+.
+			def initialize( id, peer_uuid, io, close )
+				@id = id
+				@peer_uuid = peer_uuid
+				@io = io
+				@close = close
+				@chunks = 0
+				@bytes = 0
+				@complete = false
+				@closed = false
+			end
+
+
+			##
+			# The ID of the stream
+			attr_reader :id
+
+			##
+			# The UUID of the peer sending the stream
+			attr_reader :peer_uuid
+
+			##
+			# The IO the stream is being written to
+			attr_reader :io
+
+			##
+			# The number of chunks received so far
+			attr_reader :chunks
+
+			##
+			# The number of bytes received so far
+			attr_reader :bytes
+
+
+			### Returns +true+ if the whole stream has been received.
+			def complete?
+				return @complete
+			end
+
+
+			### Write the given +chunk+, which should have the given +sequence+ number.
+			### If it can't be written, the stream is aborted.
+			def write( sequence, chunk )
+				raise Zyre::Stream::Error, "stream %s: expected chunk %d, got %d" %
+					[ @id, @chunks, sequence ] unless sequence == @chunks
+
+				@io.write( chunk )
+				@chunks += 1
+				@bytes += chunk.bytesize
+			rescue
+				self.abort
+				raise
+			end
+
+
+			### Finish the stream, which the sender says had +count+ chunks. The IO is
+			### closed (if the transfer opened it) even if the count doesn't match.
+			def finish( count )
+				raise Zyre::Stream::Error, "stream %s: expected %d chunks, got %d" %
+					[ @id, count, @chunks ] unless count == @chunks
+
+				@io.flush
+				@complete = true
+			ensure
+				self.close_io
+			end
+
+
+			### Give up on the stream without finishing it, closing the IO if the
+			### transfer opened it.
+			def abort
+				self.close_io
+			end
+
+
+			#########
+			protected
+			#########
+
+			### Close the IO if the transfer opened it and hasn't closed it already.
+			def close_io
+				return if @closed || !@close
+				@closed = true
+				@io.close
+			end
+
+		end # class Transfer
+
+
+		### Create a reassembler for streams sent to +node+. If a block is given, it's
+		### called with the stream ID and peer UUID of each new stream, and should return
+		### an IO to write it to, which is closed when the stream is complete. Otherwise
+		### the +destination+ is either an IO to write every stream to, or the path to a
+		### directory to write each stream to a file named after its ID.
+		def initialize( node, destination=nil, &opener )
+			raise ArgumentError, "no destination or block given" unless destination || opener
+
+			@node = node
+			@destination = destination
+			@opener = opener
+			@transfers = {}
+		end
+
+
+		######
+		public
+		######
+
+		##
+		# The node the streams are being sent to
+		attr_reader :node
+
+
+		### If +event+ is a stream message, handle it and return the Transfer it
+		### belongs to. Returns +nil+ for any other event. If a stream message can't
+		### be handled, its stream is aborted before the error is raised. An EXIT
+		### event aborts any streams from the peer that left, but still returns +nil+
+		### so the caller can handle it too.
+		def handle( event )
+			self.drop_transfers_from( event.peer_uuid ) if event.kind_of?( Zyre::Event::Exit )
+			return nil unless Zyre::Stream.stream_event?( event )
+
+			case event.frame( 1 )
+			when 'DATA' then return self.handle_data( event )
+			when 'END' then return self.handle_end( event )
+			else return nil
+			end
+		end
+
+
+		### Return the Transfers which have been started but not completed.
+		def pending
+			return @transfers.values
+		end
+
+
+		#########
+		protected
+		#########
+
+		### Write a chunk of a stream and acknowledge it.
+		def handle_data( event )
+			transfer = self.transfer_for( event )
+
+			begin
+				transfer.write( event.frame(3).to_i, event.frame(4) )
+			rescue
+				@transfers.delete( [transfer.peer_uuid, transfer.id] )
+				raise
+			end
+
+			@node.whisper( transfer.peer_uuid, PROTOCOL, 'ACK', transfer.id, transfer.chunks.to_s )
+
+			return transfer
+		end
+
+
+		### Complete a stream.
+		def handle_end( event )
+			transfer = self.transfer_for( event )
+			@transfers.delete( [transfer.peer_uuid, transfer.id] )
+			transfer.finish( event.frame(3).to_i )
+			self.log.debug "Stream %s from %s complete: %d bytes" %
+				[ transfer.id, transfer.peer_uuid, transfer.bytes ]
+
+			return transfer
+		end
+
+
+		### Return the Transfer for the stream +event+ belongs to, starting a new one if
+		### it's the first message of the stream.
+		def transfer_for( event )
+			id = event.frame( 2 )
+			raise Zyre::Stream::Error, "invalid stream ID %p" % [ id ] unless ID_PATTERN.match?( id )
+			return @transfers[ [event.peer_uuid, id] ] ||= self.start_transfer( id, event.peer_uuid )
+		end
+
+
+		### Abort and forget any unfinished streams from the peer with the given
+		### +peer_uuid+.
+		def drop_transfers_from( peer_uuid )
+			@transfers.delete_if do |(uuid, id), transfer|
+				next false unless uuid == peer_uuid
+				self.log.warn "Dropping unfinished stream %s from %s" % [ id, peer_uuid ]
+				transfer.abort
+				true
+			end
+		end
+
+
+		### Start a new Transfer for the stream with the given +id+ from +peer_uuid+.
+		def start_transfer( id, peer_uuid )
+			self.log.debug "Starting stream %s from %s" % [ id, peer_uuid ]
+
+			if @opener
+				return Transfer.new( id, peer_uuid, @opener.call(id, peer_uuid), true )
+			elsif @destination.respond_to?( :write )
+				return Transfer.new( id, peer_uuid, @destination, false )
+			else
+				path = File.join( @destination.to_s, id )
+				return Transfer.new( id, peer_uuid, File.open(path, 'wb'), true )
+			end
+		end
+
+	end # class Reassembler
+
+end # module Zyre::Stream
+
@@ -28,6 +28,87 @@ rescue LoadError => err
 end
 
 
+### A minimal Fiber scheduler for testing the parts of the library that wait on
+### nodes through one.
+class TestFiberScheduler
+
+	### Create a new scheduler with nothing to run.
+	def initialize
+		@readers = {}
+		@deadlines = {}
+		@ready = []
+	end
+
+
+	### Fiber::Scheduler API -- wait for the +io+ to be readable.
+	def io_wait( io, events, timeout )
+		fiber = Fiber.current
+		@readers[ fiber ] = io
+		@deadlines[ fiber ] = self.now + timeout if timeout
+		return Fiber.yield
+	ensure
+		@readers.delete( fiber )
+		@deadlines.delete( fiber )
+	end
+
+
+	### Fiber::Scheduler API -- sleep for +duration+ seconds, or forever.
+	def kernel_sleep( duration=nil )
+		self.block( :sleep, duration )
+	end
+
+
+	### Fiber::Scheduler API -- block the current fiber until it's unblocked or
+	### +timeout+ seconds have passed.
+	def block( blocker, timeout=nil )
+		fiber = Fiber.current
+		@deadlines[ fiber ] = self.now + timeout if timeout
+		Fiber.yield
+	ensure
+		@deadlines.delete( fiber )
+	end
+
+
+	### Fiber::Scheduler API -- unblock the +fiber+, possibly from another thread.
+	def unblock( blocker, fiber )
+		@ready << fiber
+	end
+
+
+	### Fiber::Scheduler API -- create and start a non-blocking fiber.
+	def fiber( &block )
+		fiber = Fiber.new( blocking: false, &block )
+		fiber.resume
+		return fiber
+	end
+
+
+	### Fiber::Scheduler API -- run until every fiber has finished.
+	def close
+		until @readers.empty? && @deadlines.empty? && @ready.empty?
+			timeout = @deadlines.values.min&.-( self.now )
+			timeout = 0.01 if timeout.nil? || timeout > 0.01 || !@ready.empty?
+			readable, = IO.select( @readers.values, nil, nil, [timeout, 0].max )
+
+			@readers.select {|_, io| readable&.include?(io) }.each_key do |fiber|
+				fiber.resume( IO::READABLE )
+			end
+			@deadlines.select {|_, deadline| deadline <= self.now }.each_key do |fiber|
+				fiber.resume( @readers.key?(fiber) ? false : nil )
+			end
+			@ready.shift.resume until @ready.empty?
+		end
+	end
+
+
+	### Return the monotonic time.
+	def now
+		return Process.clock_gettime( Process::CLOCK_MONOTONIC )
+	end
+
+end # class TestFiberScheduler
+
+
 ### Mock with RSpec
 RSpec.configure do |config|
 	config.expect_with :rspec do |expectations|
@@ -0,0 +1,70 @@
+#!/usr/bin/env rspec -cfd
+
+require_relative '../spec_helper'
+
+require 'zyre'
+
+
+RSpec.describe Zyre::Codec do
+
+	it "round-trips the supported types" do
+		objects = [
+			nil, true, false,
+			0, 127, 128, 65_536, 2**64 - 1, -1, -33, -129, -2**63,
+			1.5, -0.25,
+			'', 'a' * 31, 'a' * 70_000, "café", "\xFF\x00".b,
+			[], [ 1, [2, [3]] ], (1..20).to_a,
+			{}, { 'a' => 1, 'b' => [nil, {'c' => 'd'}] },
+		]
+
+		objects.each do |obj|
+			expect( described_class.decode(described_class.encode(obj)) ).to eq( obj )
+		end
+	end
+
+
+	it "encodes to standard MessagePack" do
+		expect( described_class.encode(nil).bytes ).to eq( [0xc0] )
+		expect( described_class.encode(-1).bytes ).to eq( [0xff] )
+		expect( described_class.encode(300).bytes ).to eq( [0xcd, 0x01, 0x2c] )
+		expect( described_class.encode('ab').bytes ).to eq( [0xa2, 0x61, 0x62] )
+		expect( described_class.encode('x'.b).bytes ).to eq( [0xc4, 0x01, 0x78] )
+		expect( described_class.encode({'a' => [1]}).bytes ).to eq( [0x81, 0xa1, 0x61, 0x91, 0x01] )
+	end
+
+
+	it "encodes Symbols as strings" do
+		expect( described_class.decode(described_class.encode(:status)) ).to eq( 'status' )
+	end
+
+
+	it "decodes strings as UTF-8 and bin as binary" do
+		expect( described_class.decode("\xA1a".b).encoding ).to eq( Encoding::UTF_8 )
+		expect( described_class.decode("\xC4\x01a".b).encoding ).to eq( Encoding::BINARY )
+	end
+
+
+	it "refuses to encode unsupported objects" do
+		expect {
+			described_class.encode( Object.new )
+		}.to raise_error( TypeError, /can't encode object/i )
+	end
+
+
+	it "refuses to encode cyclic structures" do
+		cycle = []
+		cycle << cycle
+
+		expect {
+			described_class.encode( cycle )
+		}.to raise_error( ArgumentError, /too deeply nested/i )
+	end
+
+
+	it "rejects malformed data" do
+		expect { described_class.decode("\x92\x01".b) }.to raise_error( ArgumentError, /truncated/i )
+		expect { described_class.decode("\xC1".b) }.to raise_error( ArgumentError, /unsupported/i )
+		expect { described_class.decode("\x01\x02".b) }.to raise_error( ArgumentError, /extra bytes/i )
+	end
+
+end
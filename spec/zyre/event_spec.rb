@@ -136,6 +136,54 @@ RSpec.describe( Zyre::Event ) do
 		end
 
 
+		it "returns deduplicated frozen strings for its peer identity and group" do
+			first = described_class.synthesize( :JOIN, peer_uuid, peer_name: 'node1', group: 'agroup' )
+			second = described_class.synthesize( :JOIN, peer_uuid, peer_name: 'node1', group: 'agroup' )
+
+			expect( first.peer_uuid ).to be_frozen
+			expect( first.peer_uuid ).to be( second.peer_uuid )
+			expect( first.peer_name ).to be( second.peer_name )
+			expect( first.group ).to be_frozen
+			expect( first.group ).to be( second.group )
+			expect( first.type ).to be( :JOIN )
+		end
+
+
+		it "builds its headers once, frozen and with deduplicated names" do
+			first = described_class.synthesize( :ENTER, peer_uuid,
+				peer_addr: 'in-proc:/synthesized', headers: {'Protocol-version' => '2'} )
+			second = described_class.synthesize( :ENTER, peer_uuid,
+				peer_addr: 'in-proc:/synthesized', headers: {'Protocol-version' => '2'} )
+
+			expect( first.headers ).to eq( 'Protocol-version' => '2' )
+			expect( first.headers ).to be_frozen
+			expect( first.headers ).to be( first.headers )
+			expect( first.headers.keys.first ).to be( second.headers.keys.first )
+		end
+
+
+		it "can iterate over and index the frames of its message" do
+			event = described_class.synthesize( :WHISPER, peer_uuid, msg: ['topic', 'a body', ''] )
+
+			expect( event.each_frame.to_a ).to eq( ['topic', 'a body', ''] )
+			expect( event.frame(0) ).to eq( 'topic' )
+			expect( event.frame(-2) ).to eq( 'a body' )
+			expect( event.frame(3) ).to be_nil
+			expect( event.frame_size(1) ).to eq( 6 )
+			expect( event.frame_size(2) ).to eq( 0 )
+			expect( event.frame_size(-4) ).to be_nil
+		end
+
+
+		it "has no frames if it has no message" do
+			event = described_class.synthesize( :JOIN, peer_uuid, group: 'agroup' )
+
+			expect( event.each_frame.to_a ).to be_empty
+			expect( event.frame(0) ).to be_nil
+			expect( event.frame_size(0) ).to be_nil
+		end
+
+
 		it "raises when creating a WHISPER with no msg" do
 			expect {
 				described_class.synthesize( :WHISPER, peer_uuid )
@@ -0,0 +1,69 @@
+#!/usr/bin/env rspec -cfd
+
+require_relative '../spec_helper'
+
+require 'stringio'
+require 'zyre/log_bridge'
+
+
+RSpec.describe Zyre::LogBridge do
+
+	let( :output ) { StringIO.new }
+
+
+	before( :each ) do
+		@original_logger = Zyre.logger
+		Zyre.logger = Loggability::Logger.new( output )
+		Zyre.logger.level = :debug
+	end
+
+	after( :each ) do
+		described_class.stop
+		Zyre.logger = @original_logger
+	end
+
+
+	it "forwards czmq log output to the zyre logger" do
+		expect( described_class.start ).to be_truthy
+		expect( described_class ).to be_running
+
+		started_node {|node| node.verbose! }
+
+		wait( 3 ).for { output.string }.to_not be_empty
+		expect( described_class.drops ).to eq( 0 )
+	end
+
+
+	it "can be stopped and restarted" do
+		described_class.start
+		expect( described_class.stop ).to be_truthy
+		expect( described_class ).to_not be_running
+
+		expect( described_class.start ).to be_truthy
+		expect( described_class ).to be_running
+	end
+
+
+	it "logs czmq lines at the level of their prefix" do
+		described_class.forward_line( "W: 22-10-17 12:00:00 something's not right" )
+		described_class.forward_line( "D: 22-10-17 12:00:01 details" )
+
+		expect( output.string ).to match( /WARN.*something's not right/ )
+		expect( output.string ).to match( /DEBUG.*details/ )
+	end
+
+
+	it "logs unrecognized lines at info" do
+		described_class.forward_line( "not a czmq log line" )
+
+		expect( output.string ).to match( /INFO.*not a czmq log line/ )
+	end
+
+
+	it "rejects a non-positive capacity" do
+		expect {
+			described_class.start( capacity: 0 )
+		}.to raise_error( ArgumentError, /capacity/i )
+	end
+
+end
@@ -3,6 +3,8 @@
 require_relative '../spec_helper'
 
 require 'zyre/node'
+require 'zyre/poller'
+require 'zyre/reactor'
 
 
 RSpec.describe( Zyre::Node ) do
@@ -155,6 +157,26 @@ RSpec.describe( Zyre::Node ) do
 	end
 
 
+	it "can be asked about its peers from several threads at once" do
+		node1 = started_node()
+		node2 = started_node()
+		node1.join( 'threaded' )
+
+		enter_event = node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+
+		threads = 4.times.map do
+			Thread.new do
+				200.times.map { [node1.peers, node1.peer_address(node2.uuid), node1.own_groups] }
+			end
+		end
+
+		threads.each do |thread|
+			expect( thread.join(10) ).to be_truthy
+			expect( thread.value.uniq ).to eq([ [[node2.uuid], enter_event.peer_addr, ['threaded']] ])
+		end
+	end
+
+
 	it "can whisper to another node" do
 		node1 = started_node()
 		node2 = started_node()
@@ -189,6 +211,73 @@ RSpec.describe( Zyre::Node ) do
 	end
 
 
+	it "can receive large frames that outlive their event" do
+		node1 = started_node()
+		node2 = started_node()
+		data = SecureRandom.random_bytes( 256 * 1024 )
+
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+		node1.whisper( node2.uuid, 'blob', data )
+
+		msgs = node2.wait_for( :WHISPER, peer_uuid: node1.uuid ).multipart_msg
+		GC.start
+
+		expect( msgs.last ).to be_frozen
+		expect( msgs.last.encoding ).to eq( Encoding::ASCII_8BIT )
+		expect( msgs.last ).to eq( data )
+		expect( msgs.last[0, 16].dup ).to eq( data[0, 16] )
+	end
+
+
+	it "can compress large frames it sends to peers which decompress them" do
+		node1 = started_node {|n| n.compression_threshold = 1024 }
+		node2 = started_node {|n| n.compression_threshold = 1024 }
+		data = 'compressible ' * 10_000
+
+		expect( node1.compression_threshold ).to eq( 1024 )
+
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+		node1.whisper( node2.uuid, 'small', data )
+
+		msgs = node2.wait_for( :WHISPER, peer_uuid: node1.uuid ).multipart_msg
+		expect( msgs ).to eq([ 'small', data ])
+
+		sent = node1.compression_stats[:compressed]
+		expect( sent[:frames] ).to eq( 1 )
+		expect( sent[:raw_bytes] ).to eq( data.bytesize )
+		expect( sent[:compressed_bytes] ).to be < data.bytesize
+		expect( sent[:ratio] ).to be > 1.0
+
+		received = node2.compression_stats[:decompressed]
+		expect( received[:frames] ).to eq( 1 )
+		expect( received[:raw_bytes] ).to eq( data.bytesize )
+	end
+
+
+	it "doesn't mistake frames that look compressed for ones that are" do
+		node1 = started_node {|n| n.compression_threshold = 1024 }
+		node2 = started_node {|n| n.compression_threshold = 1024 }
+		lookalike = "\xffZZ\x01\x00\x00\x00\x05garbage".b
+		escaped = "\xffZZ\x00payload".b
+		incompressible = "\xffZZ\x01".b + Random.new( 42 ).bytes( 4096 )
+
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+		node1.whisper( node2.uuid, lookalike, escaped, incompressible )
+
+		msgs = node2.wait_for( :WHISPER, peer_uuid: node1.uuid ).multipart_msg
+		expect( msgs ).to eq([ lookalike, escaped, incompressible ])
+		expect( node2.compression_stats[:decompressed][:frames] ).to eq( 0 )
+	end
+
+
+	it "doesn't compress frames by default" do
+		node = described_class.new
+
+		expect( node.compression_threshold ).to be_nil
+		expect( node.compression_stats[:compressed][:frames] ).to eq( 0 )
+	end
+
+
 	it "can shout to a group of nodes" do
 		node1 = started_node()
 		node2 = started_node()
@@ -236,6 +325,176 @@ RSpec.describe( Zyre::Node ) do
 	end
 
 
+	it "can whisper binary data containing NUL bytes" do
+		node1 = started_node()
+		node2 = started_node()
+		data = [ 0, 1, 2, 0, 255 ].pack( 'C*' ) + "\0" * 16
+
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+		node1.whisper( node2.uuid, 'binary', data )
+
+		ev = node2.wait_for( :WHISPER, peer_uuid: node1.uuid )
+		expect( ev.multipart_msg ).to eq( ['binary', data] )
+	end
+
+
+	it "can shout frozen Strings without copying them" do
+		node1 = started_node()
+		node2 = started_node()
+		node1.zero_copy = true
+
+		node1.join( 'ROOFTOP' )
+		node2.join( 'ROOFTOP' )
+
+		node1.wait_for( :JOIN, group: 'ROOFTOP', peer_uuid: node2.uuid )
+		payload = SecureRandom.random_bytes( 128 * 1024 )
+		node1.shout( 'ROOFTOP', 'random.poetry'.b.freeze, TEST_SHOUT.b.freeze, payload.dup.freeze )
+
+		ev = node2.wait_for( :SHOUT, group: 'ROOFTOP' )
+		expect( node1 ).to be_zero_copy
+		expect( ev.multipart_msg ).to eq( ['random.poetry'.b, TEST_SHOUT.b, payload] )
+	end
+
+
+	it "keeps frozen Strings sent without copying alive until ZeroMQ is done with them" do
+		node1 = started_node()
+		node2 = started_node()
+		node1.zero_copy = true
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+
+		payload = SecureRandom.random_bytes( 4 * 1024 * 1024 )
+		node1.whisper( node2.uuid, payload.dup.freeze )
+
+		GC.start( full_mark: true, immediate_sweep: true )
+		GC.compact if GC.respond_to?( :compact )
+
+		ev = node2.wait_for( :WHISPER, peer_uuid: node1.uuid )
+		expect( ev.msg ).to eq( payload )
+	end
+
+
+	it "can shout a batch of messages to groups" do
+		node1 = started_node()
+		node2 = started_node()
+
+		node1.join( 'ROOFTOP' )
+		node2.join( 'ROOFTOP' )
+		node2.join( 'BASEMENT' )
+
+		node1.wait_for( :JOIN, group: 'BASEMENT', peer_uuid: node2.uuid )
+
+		results = node1.shout_batch([
+			[ 'ROOFTOP', TEST_SHOUT ],
+			[ 'BASEMENT', ['random.poetry', TEST_SHOUT] ],
+		])
+
+		expect( results ).to eq( [0, 0] )
+
+		ev = node2.wait_for( :SHOUT, group: 'ROOFTOP' )
+		expect( ev.multipart_msg ).to eq( [TEST_SHOUT.b] )
+		ev = node2.wait_for( :SHOUT, group: 'BASEMENT' )
+		expect( ev.multipart_msg ).to eq( ['random.poetry', TEST_SHOUT.b] )
+	end
+
+
+	it "can whisper a batch of messages to peers" do
+		node1 = started_node()
+		node2 = started_node()
+		node3 = started_node()
+
+		2.times { node1.wait_for(:ENTER) }
+		results = node1.whisper_batch([
+			[ node2.uuid, TEST_WHISPER ],
+			[ node3.uuid, ['poetry.snippet', TEST_WHISPER] ],
+		])
+
+		expect( results ).to eq( [0, 0] )
+		expect( node2.wait_for(:WHISPER).multipart_msg ).to eq( [TEST_WHISPER.b] )
+		expect( node3.wait_for(:WHISPER).multipart_msg ).to eq( ['poetry.snippet', TEST_WHISPER.b] )
+	end
+
+
+	it "can shout and whisper objects encoded as MessagePack" do
+		node1 = started_node()
+		node1.join( 'codec-test' )
+		node2 = started_node()
+		node2.join( 'codec-test' )
+
+		node1.wait_for( :JOIN, peer_uuid: node2.uuid )
+		payload = { 'status' => 'ok', 'load' => [0.5, 0.25], 'count' => 3 }
+
+		node2.shout_encoded( 'codec-test', payload )
+		event = node1.wait_for( :SHOUT, timeout: 3 )
+		expect( event.decoded_msg ).to eq( payload )
+
+		node2.whisper_encoded( node1.uuid, [1, nil, 'two'] )
+		event = node1.wait_for( :WHISPER, timeout: 3 )
+		expect( event.decoded_msg ).to eq( [1, nil, 'two'] )
+	end
+
+
+	it "encodes objects into the same bytes as Zyre::Codec" do
+		node1 = started_node()
+		node2 = started_node()
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+
+		payload = {
+			name: 'sensor',
+			'readings' => Array.new( 100 ) {|i| [i, i * 0.5, -i] },
+			'blob' => SecureRandom.random_bytes( 70_000 ),
+		}
+
+		node2.whisper_encoded( node1.uuid, payload )
+		event = node1.wait_for( :WHISPER, timeout: 3 )
+		expect( event.msg ).to eq( Zyre::Codec.encode(payload) )
+	end
+
+
+	it "raises without sending anything if an object can't be encoded" do
+		node1 = started_node()
+		node2 = started_node()
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+
+		expect {
+			node2.whisper_encoded( node1.uuid, ['fine', Object.new] )
+		}.to raise_error( TypeError, /can't encode/i )
+
+		expect( node1.recv_batch(timeout: 0.2).grep(Zyre::Event::Whisper) ).to be_empty
+	end
+
+
+	it "rejects malformed batches" do
+		node1 = started_node()
+
+		expect {
+			node1.shout_batch( [['ROOFTOP', 'ok'], ['ROOFTOP']] )
+		}.to raise_error( ArgumentError, /pair at index 1/i )
+		expect {
+			node1.shout_batch( [['ROOFTOP', nil]] )
+		}.to raise_error( TypeError, /nil/i )
+	end
+
+
+	it "sends only the pairs a batch had when it was called" do
+		node1 = started_node()
+		node2 = started_node()
+		pairs = []
+		growing_part = Object.new
+		growing_part.define_singleton_method( :to_str ) do
+			100.times { pairs << [node2.uuid, 'late'] }
+			'grown'
+		end
+		pairs << [ node2.uuid, ['first', growing_part] ]
+
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+		results = node1.whisper_batch( pairs )
+
+		expect( results ).to eq( [0] )
+		expect( pairs.length ).to eq( 101 )
+		expect( node2.wait_for(:WHISPER).multipart_msg ).to eq( ['first', 'grown'] )
+	end
+
+
 	it "handles unstringifiable messages gracefully" do
 		node1 = started_node()
 		node1.join( 'ROOFTOP' )
@@ -287,6 +546,133 @@ RSpec.describe( Zyre::Node ) do
 	end
 
 
+	it "can keep a local directory of its peers and groups" do
+		node1 = started_node()
+		node1.local_directory = true
+		node1.join( 'CHANNEL1' )
+
+		node2 = started_node()
+		node2.join( 'CHANNEL1' )
+		node3 = started_node()
+
+		expect( node1 ).to be_local_directory
+		node1.wait_for( :JOIN, group: 'CHANNEL1', timeout: 3 )
+		node1.wait_for( :ENTER, peer_uuid: node3.uuid, timeout: 3 ) unless node1.peer?( node3.uuid )
+
+		expect( node1.peers ).to contain_exactly( node2.uuid, node3.uuid )
+		expect( node1.peers_by_group('CHANNEL1') ).to contain_exactly( node2.uuid )
+		expect( node1.peer_groups ).to contain_exactly( 'CHANNEL1' )
+		expect( node1.own_groups ).to contain_exactly( 'CHANNEL1' )
+		expect( node1.peer_in_group?(node2.uuid, 'CHANNEL1') ).to be( true )
+		expect( node1.peer_in_group?(node3.uuid, 'CHANNEL1') ).to be( false )
+
+		generation = node1.directory_generation
+		node2.leave( 'CHANNEL1' )
+		node1.wait_for( :LEAVE, peer_uuid: node2.uuid, timeout: 3 )
+
+		expect( node1.directory_generation ).to be > generation
+		expect( node1.peers_by_group('CHANNEL1') ).to be_empty
+		expect( node1.peer_groups ).to be_empty
+
+		node3.stop
+		node1.wait_for( :EXIT, peer_uuid: node3.uuid, timeout: 3 )
+
+		expect( node1.peer?(node3.uuid) ).to be( false )
+		expect( node1.peers ).to contain_exactly( node2.uuid )
+	end
+
+
+	it "can turn its local directory on and off from several threads at once" do
+		node1 = started_node()
+		node1.join( 'CHANNEL1' )
+		node2 = started_node()
+		node2.join( 'CHANNEL1' )
+		node1.wait_for( :JOIN, peer_uuid: node2.uuid, timeout: 3 )
+
+		togglers = 4.times.map do |i|
+			Thread.new { 50.times {|j| node1.local_directory = (i + j).even? } }
+		end
+		togglers.each {|thread| expect( thread.join(10) ).to be_truthy }
+
+		node1.local_directory = false
+		begin
+			GC.stress = true
+			node1.local_directory = true
+		ensure
+			GC.stress = false
+		end
+
+		expect( node1.peers ).to contain_exactly( node2.uuid )
+		expect( node1.peers_by_group('CHANNEL1') ).to contain_exactly( node2.uuid )
+		expect( node1.own_groups ).to contain_exactly( 'CHANNEL1' )
+	end
+
+
+	it "finds groups with non-ASCII names in its local directory" do
+		node1 = started_node()
+		node1.local_directory = true
+		node2 = started_node()
+		node2.join( 'CAFÉ' )
+
+		node1.join( 'CAFÉ' )
+		expect( node1.own_groups ).to contain_exactly( 'CAFÉ'.b )
+
+		node1.wait_for( :JOIN, peer_uuid: node2.uuid, timeout: 3 )
+		expect( node1.peers_by_group('CAFÉ') ).to contain_exactly( node2.uuid )
+		expect( node1.peer_in_group?(node2.uuid, 'CAFÉ') ).to be( true )
+
+		generation = node1.directory_generation
+		node1.leave( 'CAFÉ' )
+
+		expect( node1.own_groups ).to be_empty
+		expect( node1.directory_generation ).to be > generation
+	end
+
+
+	it "seeds its local directory from its actor when it's enabled" do
+		node1 = started_node()
+		node1.join( 'CHANNEL1' )
+		node2 = started_node()
+		node2.join( 'CHANNEL1' )
+
+		node1.wait_for( :JOIN, group: 'CHANNEL1', timeout: 3 )
+		node1.local_directory = true
+
+		expect( node1.peers ).to contain_exactly( node2.uuid )
+		expect( node1.peers_by_group('CHANNEL1') ).to contain_exactly( node2.uuid )
+		expect( node1.own_groups ).to contain_exactly( 'CHANNEL1' )
+		expect( node1.directory_generation ).to be > 0
+	end
+
+
+	it "keeps the headers and address of its peers in its local directory" do
+		node1 = started_node()
+		node1.local_directory = true
+		node2 = started_node() do |node|
+			node.headers = { protocol_version: 2, content_type: 'application/json' }
+		end
+
+		enter = node1.wait_for( :ENTER, peer_uuid: node2.uuid, timeout: 3 )
+
+		info = node1.peer_info( node2.uuid )
+		expect( info ).to be_frozen
+		expect( info[:uuid] ).to eq( node2.uuid )
+		expect( info[:name] ).to eq( node2.name )
+		expect( info[:address] ).to eq( enter.peer_addr )
+		expect( info[:headers] ).to be_frozen
+		expect( node1.peer_headers(node2.uuid) ).to be( info[:headers] )
+		expect( node1.peer_headers(node2.uuid) ).to include( 'Content-type' => 'application/json' )
+		expect( node1.peer_header_value(node2.uuid, 'Protocol-version') ).to eq( '2' )
+		expect( node1.peer_address(node2.uuid) ).to eq( enter.peer_addr )
+
+		node2.stop
+		node1.wait_for( :EXIT, peer_uuid: node2.uuid, timeout: 3 )
+
+		expect( node1.peer_info(node2.uuid) ).to be_nil
+		expect( node1.peer_headers(node2.uuid) ).to be_nil
+	end
+
+
 	it "knows what the headers of its peers are" do
 		node1 = started_node()
 		node2 = started_node() do |node|
@@ -325,6 +711,290 @@ RSpec.describe( Zyre::Node ) do
 	end
 
 
+	it "can buffer its events with a background reader" do
+		node1 = started_node()
+		node1.join( 'reader-test' )
+		node1.start_reader( capacity: 64 )
+
+		node2 = started_node()
+		node2.join( 'reader-test' )
+
+		node1.wait_for( :JOIN, peer_uuid: node2.uuid, timeout: 3 )
+		5.times {|i| node2.shout('reader-test', "message #{i}") }
+
+		shouts = []
+		wait( 3 ).for {
+			shouts.concat( node1.recv_batch(max: 10, timeout: 0.5).grep(Zyre::Event::Shout) )
+			shouts.size
+		}.to eq( 5 )
+
+		expect( shouts.map(&:msg) ).to eq( (0..4).map {|i| "message #{i}" } )
+
+		stats = node1.reader_stats
+		expect( stats ).to include( capacity: 64, depth: 0, overflows: 0, running: true )
+		expect( stats[:high_water] ).to be_between( 1, 64 )
+
+		expect( node1.stop_reader ).to be_truthy
+		expect( node1.reader_stats ).to be_nil
+	end
+
+
+	it "counts the events its background reader drops when its buffer is full" do
+		node1 = started_node()
+		node1.join( 'reader-test' )
+		node1.start_reader( capacity: 2 )
+
+		node2 = started_node()
+		node2.join( 'reader-test' )
+
+		wait( 3 ).for { node1.reader_stats[:depth] }.to eq( 2 )
+		10.times {|i| node2.shout('reader-test', "message #{i}") }
+
+		wait( 3 ).for { node1.reader_stats[:overflows] }.to be >= 10
+		expect( node1.reader_stats[:high_water] ).to eq( 2 )
+	end
+
+
+	it "wakes every thread waiting on its background reader" do
+		node1 = started_node()
+		node1.filter = { types: [:WHISPER] }
+		node1.start_reader
+
+		node2 = started_node()
+		node2.wait_for( :ENTER, peer_uuid: node1.uuid, timeout: 3 )
+
+		patient = Thread.new { node1.recv }
+		impatient = Thread.new { node1.recv(timeout: 0.25) }
+
+		expect( impatient.value ).to be_nil
+		node2.whisper( node1.uuid, 'for the patient one' )
+
+		expect( patient.join(5) ).to be_truthy
+		expect( patient.value.msg ).to eq( 'for the patient one' )
+	end
+
+
+	it "can stop its background reader while another thread is waiting on it" do
+		node = started_node()
+		node.start_reader
+
+		waiter = Thread.new { node.recv(timeout: 5) }
+		wait( 3 ).for { waiter.status }.to eq( 'sleep' )
+
+		expect( node.stop_reader ).to be_truthy
+		expect( waiter.join(5) ).to be_truthy
+		expect( waiter.value ).to be_nil
+		expect( node.reader_stats ).to be_nil
+	end
+
+
+	it "can't be polled by anything else while its background reader is running" do
+		node = started_node()
+		poller = Zyre::Poller.new( node )
+		node.start_reader
+
+		expect { Zyre.wait(node, timeout: 0) }.to raise_error( RuntimeError, /background reader/i )
+		expect { Zyre::Poller.new(node) }.to raise_error( RuntimeError, /background reader/i )
+		expect { poller.wait(0) }.to raise_error( RuntimeError, /background reader/i )
+		expect { poller.wait_all(0) }.to raise_error( RuntimeError, /background reader/i )
+		expect {
+			Zyre::Reactor.new.register( node ) {}
+		}.to raise_error( RuntimeError, /background reader/i )
+
+		node.stop_reader
+		expect { Zyre.wait(node, timeout: 0) }.to_not raise_error
+	end
+
+
+	it "can't start a background reader while something else is polling it" do
+		node = described_class.new
+		reactor = Zyre::Reactor.new
+		reactor.register( node ) {}
+
+		waiter = Thread.new { Zyre.wait(node, timeout: 1) }
+		wait( 3 ).for { waiter.status }.to eq( 'sleep' )
+		expect { node.start_reader }.to raise_error( RuntimeError, /being polled/i )
+		waiter.join
+
+		receiver = Thread.new { node.recv(timeout: 1) }
+		wait( 3 ).for { receiver.status }.to eq( 'sleep' )
+		expect { node.start_reader }.to raise_error( RuntimeError, /being polled/i )
+		receiver.join
+
+		error = nil
+		reactor.after( 0.1 ) do
+			node.start_reader
+		rescue => err
+			error = err
+		ensure
+			reactor.stop
+		end
+		reactor.run
+		expect( error ).to be_a( RuntimeError )
+		expect( error.message ).to match( /being polled/i )
+
+		expect( node.start_reader ).to be( true )
+	end
+
+
+	it "doesn't allow more than one background reader" do
+		node = started_node()
+		node.start_reader
+
+		expect { node.start_reader }.to raise_error( RuntimeError, /already has a reader/i )
+	end
+
+
+	it "can filter its events by type and group before they're wrapped" do
+		node1 = started_node()
+		node1.filter = { types: [:SHOUT], groups: ['filter-a'] }
+		node1.join( 'filter-a' )
+		node1.join( 'filter-b' )
+
+		node2 = started_node()
+		node2.wait_for( :JOIN, peer_uuid: node1.uuid, group: 'filter-b', timeout: 3 )
+
+		node2.shout( 'filter-b', 'dropped' )
+		node2.shout( 'filter-a', 'kept' )
+
+		event = node1.recv( timeout: 3 )
+
+		expect( event ).to be_a( Zyre::Event::Shout )
+		expect( event.msg ).to eq( 'kept' )
+		expect( node1.filter_stats ).to include( groups: 1 )
+		expect( node1.filter_stats[:types] ).to be >= 1
+	end
+
+
+	it "can filter its events by peer" do
+		node2 = started_node()
+		node3 = started_node()
+		node1 = started_node()
+		node1.filter = { types: Zyre::Event::Whisper, deny_peers: [node2.uuid] }
+
+		node2.wait_for( :ENTER, peer_uuid: node1.uuid, timeout: 3 )
+		node3.wait_for( :ENTER, peer_uuid: node1.uuid, timeout: 3 )
+
+		node2.whisper( node1.uuid, 'denied' )
+		node3.whisper( node1.uuid, 'allowed' )
+
+		event = node1.recv( timeout: 3 )
+
+		expect( event.peer_uuid ).to eq( node3.uuid )
+		expect( event.msg ).to eq( 'allowed' )
+		expect( node1.filter_stats[:peers] ).to eq( 1 )
+		expect( node1.filter ).to eq({ types: Zyre::Event::Whisper, deny_peers: [node2.uuid] })
+	end
+
+
+	it "keeps waiting through a Fiber scheduler when its filter drops an event" do
+		node1 = started_node()
+		node1.filter = { types: [:WHISPER] }
+
+		node2 = started_node()
+		node2.wait_for( :ENTER, peer_uuid: node1.uuid, timeout: 3 )
+
+		receiver = Thread.new do
+			Fiber.set_scheduler( TestFiberScheduler.new )
+			event = nil
+			Fiber.schedule { event = node1.recv }
+			Fiber.set_scheduler( nil )
+			event
+		end
+
+		sleep 0.25
+		node2.join( 'filter-fiber' )
+		sleep 0.25
+		node2.whisper( node1.uuid, 'after the drop' )
+
+		expect( receiver.join(5) ).to be_truthy
+		expect( receiver.value ).to be_a( Zyre::Event::Whisper )
+		expect( receiver.value.msg ).to eq( 'after the drop' )
+		expect( node1.filter_stats[:types] ).to be >= 1
+	end
+
+
+	it "still updates its local directory from events its filter drops" do
+		node1 = started_node()
+		node1.local_directory = true
+		node1.filter = { types: [:WHISPER] }
+
+		node2 = started_node()
+		node2.join( 'filter-directory' )
+
+		wait( 3 ).for {
+			node1.recv( timeout: 0.1 )
+			node1.peer_in_group?( node2.uuid, 'filter-directory' )
+		}.to be( true )
+	end
+
+
+	it "can have its filter removed" do
+		node = Zyre::Node.new
+		node.filter = { types: [:ENTER] }
+		node.filter = nil
+
+		expect( node.filter ).to be_nil
+	end
+
+
+	it "rejects filters for unknown event types" do
+		node = Zyre::Node.new
+
+		expect {
+			node.filter = { types: [:BLARGH] }
+		}.to raise_error( ArgumentError, /no such event type/i )
+	end
+
+
+	it "can read a batch of waiting events" do
+		node1 = started_node()
+		node1.join( 'batch-test' )
+
+		node2 = started_node()
+		node2.join( 'batch-test' )
+
+		node1.wait_for( :JOIN, peer_uuid: node2.uuid )
+		5.times {|i| node2.shout('batch-test', "message #{i}") }
+
+		shouts = []
+		wait( 3 ).for {
+			batch = node1.recv_batch( max: 3, timeout: 0.5 )
+			expect( batch.size ).to be <= 3
+			shouts.concat( batch.grep(Zyre::Event::Shout) )
+			shouts.size
+		}.to eq( 5 )
+
+		expect( shouts.map(&:msg) ).to eq( (0..4).map {|i| "message #{i}" } )
+	end
+
+
+	it "returns an empty batch if no events arrive before the timeout" do
+		node = started_node()
+
+		expect( node.recv_batch(max: 10, timeout: 0.1) ).to eq( [] )
+	end
+
+
+	it "can receive an event with a timeout" do
+		node1 = started_node()
+		node2 = started_node()
+
+		event = node1.recv( timeout: 3 )
+		event = node1.recv( timeout: 3 ) until event.nil? || event.type == :ENTER
+
+		expect( event ).to be_a( Zyre::Event::Enter )
+		expect( event.peer_uuid ).to eq( node2.uuid )
+	end
+
+
+	it "returns nil from a timed receive if no event arrives" do
+		node = started_node()
+
+		expect( node.recv(timeout: 0.1) ).to be_nil
+	end
+
+
 	it "can wait for a specified event type" do
 		node1 = started_node()
 		node1.join( 'wait-test' )
@@ -29,6 +29,17 @@ RSpec.describe Zyre::Poller do
 	end
 
 
+	it "can have nodes removed from it" do
+		n1 = Zyre::Node.new
+		n2 = Zyre::Node.new
+
+		instance = described_class.new( n1, n2 )
+		instance.remove( n1 )
+
+		expect( instance.nodes ).to eq({ n2.endpoint => n2 })
+	end
+
+
 	it "returns nil if no input arrives before the timeout" do
 		n1 = Zyre::Node.new
 		n2 = Zyre::Node.new
@@ -40,5 +51,46 @@ RSpec.describe Zyre::Poller do
 		expect( rval ).to be_nil
 	end
 
+
+	it "can return every node that has input" do
+		n1 = started_node()
+		n2 = started_node()
+
+		instance = described_class.new( n1, n2 )
+
+		wait( 3 ).for { instance.wait_all(0.1).size }.to eq( 2 )
+		expect( instance.wait_all(0.1) ).to contain_exactly( n1, n2 )
+	end
+
+
+	it "rotates the order of the nodes it returns from #wait_all" do
+		n1 = started_node()
+		n2 = started_node()
+
+		instance = described_class.new( n1, n2 )
+		wait( 3 ).for { instance.wait_all(0.1).size }.to eq( 2 )
+
+		first = instance.wait_all( 0.1 )
+		second = instance.wait_all( 0.1 )
+
+		expect( second ).to eq( first.reverse )
+	end
+
+
+	it "returns an empty Array from #wait_all if no input arrives before the timeout" do
+		instance = described_class.new( Zyre::Node.new, Zyre::Node.new )
+
+		expect( instance.wait_all(0.25, order: :least_recent) ).to eq( [] )
+	end
+
+
+	it "rejects unknown #wait_all orderings" do
+		instance = described_class.new( Zyre::Node.new )
+
+		expect {
+			instance.wait_all( 0.1, order: :random )
+		}.to raise_error( ArgumentError, /unknown order/i )
+	end
+
 end
 
@@ -0,0 +1,111 @@
+#!/usr/bin/env rspec -cfd
+
+require_relative '../spec_helper'
+
+require 'zyre/reactor'
+
+
+RSpec.describe Zyre::Reactor do
+
+	let( :reactor ) { described_class.new }
+
+
+	it "calls the handlers registered for the types of events nodes receive" do
+		node1 = started_node()
+		node2 = started_node()
+		whispers = []
+		others = []
+
+		reactor.register( node2, :ENTER ) do |event|
+			node2.whisper( event.peer_uuid, 'hello' ) if event.peer_uuid == node1.uuid
+		end
+		reactor.register( node1, Zyre::Event::Whisper ) do |event|
+			whispers << event
+			reactor.stop
+		end
+		reactor.register( node1, :SHOUT ) {|event| others << event }
+
+		reactor.run_for( 5 )
+
+		expect( whispers.length ).to eq( 1 )
+		expect( whispers.first ).to be_a( Zyre::Event::Whisper )
+		expect( whispers.first.peer_uuid ).to eq( node2.uuid )
+		expect( whispers.first.msg ).to eq( 'hello' )
+		expect( others ).to be_empty
+		expect( reactor ).to_not be_running
+	end
+
+
+	it "can unregister a node" do
+		node = Zyre::Node.new
+		reactor.register( node ) {}
+
+		expect( reactor ).to be_registered( node )
+		expect( reactor.unregister(node) ).to be( true )
+		expect( reactor ).to_not be_registered( node )
+		expect( reactor.unregister(node) ).to be( false )
+	end
+
+
+	it "can call a block repeatedly on a timer" do
+		ticks = []
+		reactor.every( 0.01 ) do |timer_id|
+			ticks << timer_id
+			reactor.stop if ticks.length == 3
+		end
+
+		reactor.run_for( 5 )
+
+		expect( ticks.length ).to eq( 3 )
+		expect( ticks.uniq.length ).to eq( 1 )
+	end
+
+
+	it "can call a block once after a delay" do
+		fired = 0
+		reactor.after( 0.01 ) { fired += 1 }
+
+		reactor.run_for( 0.25 )
+
+		expect( fired ).to eq( 1 )
+	end
+
+
+	it "can cancel a timer" do
+		timer_id = reactor.after( 0.01 ) { raise "timer wasn't cancelled" }
+
+		expect( reactor.cancel_timer(timer_id) ).to be( true )
+		expect { reactor.run_for(0.1) }.to_not raise_error
+		expect( reactor.cancel_timer(timer_id) ).to be( false )
+	end
+
+
+	it "stops and re-raises exceptions raised by handlers" do
+		reactor.after( 0.01 ) { raise "kaboom" }
+
+		expect { reactor.run_for(5) }.to raise_error( RuntimeError, 'kaboom' )
+		expect( reactor ).to_not be_running
+	end
+
+
+	it "can be stopped from another thread" do
+		thread = Thread.new { reactor.run }
+		sleep 0.1 until reactor.running?
+
+		expect( reactor.stop ).to be( true )
+		expect( thread.join(5) ).to be_truthy
+		expect( reactor ).to_not be_running
+		expect( reactor.stop ).to be( false )
+	end
+
+
+	it "raises when registering for an unknown type of event" do
+		node = Zyre::Node.new
+
+		expect {
+			reactor.register( node, :BLARGH ) {}
+		}.to raise_error( ArgumentError, /no such event type/i )
+	end
+
+end
+
@@ -0,0 +1,156 @@
+#!/usr/bin/env rspec -cfd
+
+require_relative '../spec_helper'
+
+require 'stringio'
+require 'tmpdir'
+require 'zyre/stream'
+
+
+RSpec.describe Zyre::Stream do
+
+	### Start a thread that feeds the events of +node+ to the +reassembler+ until a
+	### stream is complete, and returns its Transfer.
+	def receive_stream( node, reassembler )
+		return Thread.new do
+			node.each_event do |event|
+				transfer = reassembler.handle( event ) or next
+				break transfer if transfer.complete?
+			end
+		end
+	end
+
+
+	let( :data ) { SecureRandom.random_bytes(1024 * 1024 + 7) }
+
+
+	it "can stream an IO to a peer in chunks" do
+		node1 = started_node()
+		node2 = started_node()
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+		node2.wait_for( :ENTER, peer_uuid: node1.uuid )
+
+		output = StringIO.new( ''.b )
+		receiver = receive_stream( node2, described_class::Reassembler.new(node2, output) )
+
+		bytes = node1.whisper_stream( node2.uuid, StringIO.new(data), chunk_size: 64 * 1024, window: 4 )
+		transfer = receiver.value
+
+		expect( bytes ).to eq( data.bytesize )
+		expect( transfer ).to be_complete
+		expect( transfer.peer_uuid ).to eq( node1.uuid )
+		expect( transfer.chunks ).to eq( 17 )
+		expect( output.string ).to eq( data )
+	end
+
+
+	it "can reassemble streams into files in a directory" do
+		node1 = started_node()
+		node2 = started_node()
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+		node2.wait_for( :ENTER, peer_uuid: node1.uuid )
+
+		Dir.mktmpdir do |dir|
+			receiver = receive_stream( node2, described_class::Reassembler.new(node2, dir) )
+			node1.whisper_stream( node2.uuid, StringIO.new(data), chunk_size: 100_000 )
+			transfer = receiver.value
+
+			expect( transfer.io ).to be_closed
+			expect( File.binread(File.join(dir, transfer.id)) ).to eq( data )
+		end
+	end
+
+
+	it "raises if the peer doesn't acknowledge chunks in time" do
+		node1 = started_node()
+		node2 = started_node()
+		node1.wait_for( :ENTER, peer_uuid: node2.uuid )
+
+		expect {
+			node1.whisper_stream( node2.uuid, StringIO.new(data), chunk_size: 1024, window: 2, timeout: 0.5 )
+		}.to raise_error( described_class::Error, /timed out/i )
+	end
+
+
+	it "rejects chunks that arrive out of sequence" do
+		transfer = described_class::Reassembler::Transfer.new( 'a' * 16, 'peer', StringIO.new, false )
+		transfer.write( 0, 'one' )
+
+		expect {
+			transfer.write( 2, 'three' )
+		}.to raise_error( described_class::Error, /expected chunk 1, got 2/i )
+	end
+
+
+	describe "reassembler" do
+
+		let( :node ) { instance_double(Zyre::Node, whisper: 0) }
+		let( :factory ) { Zyre::Testing::EventFactory.new }
+		let( :stream_id ) { SecureRandom.hex(8) }
+		let( :ios ) { [] }
+		let( :reassembler ) do
+			described_class::Reassembler.new( node ) do |id, peer_uuid|
+				StringIO.new( ''.b ).tap {|io| ios << io }
+			end
+		end
+
+
+		### Return a stream message from the +factory+'s peer.
+		def stream_message( *frames, **overrides )
+			return factory.whisper( nil, described_class::PROTOCOL, *frames, **overrides )
+		end
+
+
+		it "closes the IO and forgets the stream if a chunk arrives out of sequence" do
+			reassembler.handle( stream_message('DATA', stream_id, '0', 'one') )
+
+			expect {
+				reassembler.handle( stream_message('DATA', stream_id, '2', 'three') )
+			}.to raise_error( described_class::Error, /expected chunk 1, got 2/i )
+
+			expect( ios.first ).to be_closed
+			expect( reassembler.pending ).to be_empty
+		end
+
+
+		it "closes the IO and forgets the stream if it ends with the wrong number of chunks" do
+			reassembler.handle( stream_message('DATA', stream_id, '0', 'one') )
+
+			expect {
+				reassembler.handle( stream_message('END', stream_id, '2') )
+			}.to raise_error( described_class::Error, /expected 2 chunks, got 1/i )
+
+			expect( ios.first ).to be_closed
+			expect( reassembler.pending ).to be_empty
+		end
+
+
+		it "drops the unfinished streams of a peer that exits" do
+			other_peer = SecureRandom.uuid
+			reassembler.handle( stream_message('DATA', stream_id, '0', 'one') )
+			reassembler.handle( stream_message('DATA', stream_id, '0', 'uno', peer_uuid: other_peer) )
+
+			expect( reassembler.handle(factory.exit) ).to be_nil
+
+			expect( ios.first ).to be_closed
+			expect( ios.last ).to_not be_closed
+			expect( reassembler.pending.map(&:peer_uuid) ).to eq( [other_peer] )
+		end
+
+
+		it "keeps streams with the same ID from different peers apart" do
+			other_peer = SecureRandom.uuid
+			reassembler.handle( stream_message('DATA', stream_id, '0', 'one') )
+			reassembler.handle( stream_message('DATA', stream_id, '0', 'uno', peer_uuid: other_peer) )
+			transfer = reassembler.handle( stream_message('END', stream_id, '1', peer_uuid: other_peer) )
+
+			expect( transfer ).to be_complete
+			expect( transfer.peer_uuid ).to eq( other_peer )
+			expect( ios.map(&:string) ).to eq( ['one', 'uno'] )
+			expect( reassembler.pending.map(&:peer_uuid) ).to eq( [factory.peer_uuid] )
+		end
+
+	end
+
+end
+
@@ -36,6 +36,87 @@ RSpec.describe Zyre do
 	end
 
 
+	it "can wait on several nodes for one to become readable" do
+		node1 = started_node()
+		node2 = Zyre::Node.new
+
+		expect( described_class.wait(node1, node2, timeout: 0.1) ).to be_nil
+
+		node3 = started_node()
+
+		expect( described_class.wait(node2, node1, timeout: 2) ).to be( node1 )
+		expect( described_class.wait([node2, node3], timeout: 2) ).to be( node3 )
+	end
+
+
+	it "isn't affected by changes to its Array of nodes while it waits in a fiber" do
+		node1 = started_node()
+		node2 = Zyre::Node.new
+		nodes = [ node2, node1 ]
+
+		waiter = Thread.new do
+			Fiber.set_scheduler( TestFiberScheduler.new )
+			result = nil
+			Fiber.schedule { result = described_class.wait2(nodes, 3) }
+			Fiber.schedule { nodes.clear; nodes.concat(Array.new(100) { Object.new }) }
+			Fiber.set_scheduler( nil )
+			result
+		end
+
+		started_node()
+
+		expect( waiter.join(5) ).to be_truthy
+		expect( waiter.value ).to be( node1 )
+		expect( nodes.length ).to eq( 100 )
+	end
+
+
+	it "returns nil when waiting on no nodes" do
+		expect( described_class.wait(timeout: 0.1) ).to be_nil
+	end
+
+
+	it "keeps the native log level in sync with its logger" do
+		original_level = described_class.logger.level
+
+		described_class.logger.level = :info
+		expect( described_class.native_log_level ).to eq( Logger::INFO )
+
+		described_class.logger.level = :debug
+		expect( described_class.native_log_level ).to eq( Logger::DEBUG )
+	ensure
+		described_class.logger.level = original_level
+	end
+
+
+	it "keeps the native log level in sync when its logger is replaced" do
+		original_logger = described_class.logger
+		replacement = Loggability::Logger.new( $stderr )
+		replacement.level = :error
+
+		described_class.logger = replacement
+		expect( described_class.native_log_level ).to eq( Logger::ERROR )
+
+		described_class.logger.level = :warn
+		expect( described_class.native_log_level ).to eq( Logger::WARN )
+	ensure
+		described_class.logger = original_logger
+	end
+
+
+	it "can be used from Ractors other than the main one" do
+		skip "Ractors aren't supported" unless defined?( Ractor )
+
+		ractor = Ractor.new do
+			node = Zyre::Node.new
+			[ node.uuid.length, Zyre::Codec.decode(Zyre::Codec.encode([1, 'two'])) ]
+		end
+		result = ractor.respond_to?( :value ) ? ractor.value : ractor.take
+
+		expect( result ).to eq([ 32, [1, 'two'] ])
+	end
+
+
 	it "can normalize symbol-keyed headers into an RFC822-style string Hash" do
 		headers = {
 			protocol_version: 2,